@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "dispatch_bench.h"
+#include "pom_rewriter_fns.h"
+#include "xml_graph.h"
+#include "xml_name.h"
+#include "xml_parser.h"
+
+namespace pommade {
+using namespace std;
+using namespace std::placeholders;
+using namespace xml_graph;
+using namespace xml_parser;
+
+namespace {
+using bench_clock = chrono::steady_clock;
+
+// pom_rewriter's walk over dependencies, exclusions included, with each step reduced to summing its leaves' content sizes, so that
+// dispatch is most of what's timed; mapped: steps are reached as they were before the constexpr tables, through a lazily filled
+// map of bound std::functions
+template <bool mapped> class dependency_walker : private pom_rewriter_fns {
+  friend struct pom_rewriter_fns;
+  using node_type = size_t;
+
+  static constexpr size_t (dependency_walker::*const rw_fns[rw_key_cnt])(const xml_node&, bool){nullptr, nullptr, &dependency_walker::walk_exclusion, &dependency_walker::walk_exclusions, &dependency_walker::walk_dependency, &dependency_walker::walk_dependencies};
+
+  std::unordered_map<unsigned short int, function<size_t(const xml_node&, bool)>> rw_fn_map;
+
+  const function<size_t(const xml_node&, bool)>& get_mapped_rw_fn(rw_keys key) {
+    const auto cit = rw_fn_map.find(static_cast<unsigned short int>(key));
+    if (cit != rw_fn_map.cend())
+      return cit->second;
+    return rw_fn_map.emplace(static_cast<unsigned short int>(key), bind(rw_fns[key], this, _1, _2)).first->second;
+  }
+
+  template <typename RwFn>
+  size_t walk_subnodes(const xml_node& node, const RwFn& rw_fn) {
+    size_t size{};
+    const auto cend = node.tree().cend();
+    for (auto cit = node.tree().cbegin(); cit != cend; ++cit) {
+      size += rw_fn(*cit, false);
+      ++call_cnt;
+    }
+    return size;
+  }
+
+  static size_t walk_leaves(const xml_node& node) {
+    size_t size{};
+    const auto cend = node.tree().cend();
+    for (auto cit = node.tree().cbegin(); cit != cend; ++cit)
+      size += cit->get_content().size();
+    return size;
+  }
+
+  size_t walk_exclusion(const xml_node& node, bool gap_before) { return walk_leaves(node); }
+  size_t walk_exclusions(const xml_node& node, bool gap_before) { return mapped ? walk_subnodes(node, get_mapped_rw_fn(rw_exclusion)) : walk_subnodes(node, rw_fn<dependency_walker, rw_exclusion>{this}); }
+  size_t walk_dependency(const xml_node& node, bool gap_before) {
+    size_t size{walk_leaves(node)};
+    for (auto cit = node.tree().cbegin(); cit != node.tree().cend(); ++cit) {
+      if (cit->name == xml_names::exclusions) {
+        size += mapped ? get_mapped_rw_fn(rw_exclusions)(*cit, false) : rw_fn<dependency_walker, rw_exclusions>{this}(*cit, false);
+        ++call_cnt;
+      }
+    }
+    return size;
+  }
+  size_t walk_dependencies(const xml_node& node, bool gap_before) { return mapped ? walk_subnodes(node, get_mapped_rw_fn(rw_dependency)) : walk_subnodes(node, rw_fn<dependency_walker, rw_dependency>{this}); }
+
+ public:
+  size_t call_cnt;
+
+  dependency_walker() : call_cnt{} {}
+
+  // every dependencies section in the document, wherever it is
+  size_t walk(const xml_node& root) {
+    size_t size{};
+    const xml_node* const end{&root + root.get_span()};
+    for (const xml_node* nodep{&root}; nodep != end; ++nodep) {
+      if (nodep->name == xml_names::dependencies) {
+        size += mapped ? get_mapped_rw_fn(rw_dependencies)(*nodep, false) : rw_fn<dependency_walker, rw_dependencies>{this}(*nodep, false);
+        ++call_cnt;
+      }
+    }
+    return size;
+  }
+};
+
+template <bool mapped> constexpr size_t (dependency_walker<mapped>::*const dependency_walker<mapped>::rw_fns[rw_key_cnt])(const xml_node&, bool);
+
+// a fresh walker per run, as each document got a fresh pom_rewriter (and so a fresh map); the best of the runs in min_secs
+template <bool mapped>
+double
+time_walks(const xml_node& root, double min_secs, size_t& call_cnt, size_t& size) {
+  double best_secs{};
+  const auto start = bench_clock::now();
+  do {
+    const auto run_start = bench_clock::now();
+    dependency_walker<mapped> walker;
+    size = walker.walk(root);
+    const double secs{chrono::duration<double>(bench_clock::now() - run_start).count()};
+    if (!best_secs || secs < best_secs)
+      best_secs = secs;
+    call_cnt = walker.call_cnt;
+  } while (chrono::duration<double>(bench_clock::now() - start).count() < min_secs);
+  return best_secs;
+}
+}
+
+void
+bench_dispatch(const string& pom, double min_secs, xml_parser_backend backend) {
+  default_xml_doc_handler doc_handler;
+  xml_doc_parser doc_parser{doc_handler, backend};
+  const xml_doc<xml_node> doc{doc_parser.parse_doc(pom.data(), pom.size(), "synthetic")};
+  size_t mapped_call_cnt, table_call_cnt, mapped_size, table_size;
+  const double mapped_secs{time_walks<true>(*doc.get(), min_secs, mapped_call_cnt, mapped_size)};
+  const double table_secs{time_walks<false>(*doc.get(), min_secs, table_call_cnt, table_size)};
+  if (mapped_call_cnt != table_call_cnt || mapped_size != table_size)
+    throw logic_error{"the two dispatch paths walked different nodes"};
+  cout << setw(10) << pom.size() << setw(10) << table_call_cnt << setw(16) << fixed << setprecision(2) << mapped_secs * 1e9 / mapped_call_cnt << setw(16) << table_secs * 1e9 / table_call_cnt << setw(10) << mapped_secs / table_secs << 'x' << endl;
+}
+}
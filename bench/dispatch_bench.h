@@ -0,0 +1,15 @@
+#ifndef DISPATCH_BENCH_H
+#define DISPATCH_BENCH_H
+
+#include <string>
+
+#include "xml_parser.h"
+
+namespace pommade {
+
+// times the rewriter's per-node dispatch on its own over the dependencies of a POM, both as it was (a std::function bound to the
+// step and looked up by key in an unordered_map) and as it is (pom_rewriter_fns' functors over a constexpr table), and writes the
+// time per call of each to standard output
+void bench_dispatch(const std::string& pom, double min_secs, xml_parser::xml_parser_backend backend);
+}
+#endif
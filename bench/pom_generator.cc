@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pom_generator.h"
+
+namespace pommade {
+using namespace std;
+
+namespace {
+// a small, fast and (unlike the <random> distributions) portably reproducible generator
+class lcg {
+  uint32_t state;
+
+ public:
+  lcg(uint32_t seed) : state{seed} {}
+
+  unsigned int operator()(unsigned int n) {
+    state = state * 1664525U + 1013904223U;
+    return (state >> 8) % n;
+  }
+};
+
+const char* const group_ids[] = {"org.apache.commons", "com.ourco", "junit", "org.springframework", "io.netty", "com.google.guava", "org.slf4j", "com.fasterxml.jackson.core"};
+const char* const scopes[] = {"compile", "test", "provided", "runtime"};
+const char* const phases[] = {"validate", "compile", "test", "package", "verify", "install"};
+
+class pom_generator {
+  const pom_generator_params& params;
+  lcg rand;
+  string pom;
+
+  void indent(unsigned int level) { pom.append(level, '\t'); }
+
+  void leaf(unsigned int level, const char* name, const string& content) {
+    indent(level);
+    pom += '<';
+    pom += name;
+    pom += '>';
+    pom += content;
+    pom += "</";
+    pom += name;
+    pom += ">\n";
+  }
+  void open(unsigned int level, const char* name) {
+    indent(level);
+    pom += '<';
+    pom += name;
+    pom += ">\n";
+  }
+  void close(unsigned int level, const char* name) {
+    indent(level);
+    pom += "</";
+    pom += name;
+    pom += ">\n";
+  }
+
+  // emits the sections whose order the rewriter fixes in a random order
+  template <typename Fn> void shuffled(unsigned int section_cnt, Fn section_fn) {
+    vector<unsigned int> sections(section_cnt);
+    for (auto i = 0U; i < section_cnt; ++i)
+      sections[i] = i;
+    for (auto i = section_cnt; i > 1; --i)
+      swap(sections[i - 1], sections[rand(i)]);
+    for (const auto section : sections)
+      section_fn(section);
+  }
+
+  string group_id() { return string{group_ids[rand(sizeof group_ids / sizeof *group_ids)]} + ".m" + to_string(rand(64)); }
+  string version() { return to_string(rand(10)) + '.' + to_string(rand(20)) + '.' + to_string(rand(100)); }
+
+  void properties(unsigned int level, unsigned int cnt) {
+    open(level, "properties");
+    for (auto i = 0U; i < cnt; ++i) {
+      const string name{"p" + to_string(rand(cnt * 4)) + '.' + to_string(i) + ".version"};
+      leaf(level + 1, name.c_str(), version());
+    }
+    close(level, "properties");
+  }
+
+  void dependency(unsigned int level) {
+    open(level, "dependency");
+    shuffled(5, [this, level](unsigned int section) {
+      switch (section) {
+      case 0: leaf(level + 1, "groupId", group_id()); break;
+      case 1: leaf(level + 1, "artifactId", "artifact-" + to_string(rand(1000))); break;
+      case 2: leaf(level + 1, "version", version()); break;
+      case 3: leaf(level + 1, "scope", scopes[rand(sizeof scopes / sizeof *scopes)]); break;
+      case 4:
+        if (params.exclusion_cnt) {
+          open(level + 1, "exclusions");
+          for (auto i = 0U; i < params.exclusion_cnt; ++i) {
+            open(level + 2, "exclusion");
+            leaf(level + 3, "artifactId", "excluded-" + to_string(rand(100)));
+            leaf(level + 3, "groupId", group_id());
+            close(level + 2, "exclusion");
+          }
+          close(level + 1, "exclusions");
+        }
+        break;
+      }
+    });
+    close(level, "dependency");
+  }
+
+  void configuration(unsigned int level, unsigned int depth) {
+    open(level, "configuration");
+    for (auto i = 0U; i < 3; ++i) {
+      const string name{"option" + to_string(rand(50))};
+      leaf(level + 1, name.c_str(), "value-" + to_string(rand(1000)));
+    }
+    vector<string> names;
+    for (auto i = 0U; i < depth; ++i) {
+      names.push_back("nested" + to_string(i));
+      open(level + 1 + i, names.back().c_str());
+    }
+    if (depth)
+      leaf(level + 1 + depth, "leaf", "x");
+    for (auto i = depth; i-- > 0;)
+      close(level + 1 + i, names[i].c_str());
+    close(level, "configuration");
+  }
+
+  void plugin(unsigned int level, unsigned int plugin_i) {
+    open(level, "plugin");
+    shuffled(5, [this, level, plugin_i](unsigned int section) {
+      switch (section) {
+      case 0: leaf(level + 1, "groupId", "org.apache.maven.plugins"); break;
+      case 1: leaf(level + 1, "artifactId", "maven-plugin-" + to_string(plugin_i)); break;
+      case 2: leaf(level + 1, "version", version()); break;
+      case 3: configuration(level + 1, params.configuration_depth); break;
+      case 4:
+        if (params.execution_cnt) {
+          open(level + 1, "executions");
+          for (auto i = 0U; i < params.execution_cnt; ++i) {
+            open(level + 2, "execution");
+            leaf(level + 3, "phase", phases[rand(sizeof phases / sizeof *phases)]);
+            open(level + 3, "goals");
+            leaf(level + 4, "goal", "goal-" + to_string(rand(10)));
+            close(level + 3, "goals");
+            leaf(level + 3, "id", "execution-" + to_string(i));
+            close(level + 2, "execution");
+          }
+          close(level + 1, "executions");
+        }
+        break;
+      }
+    });
+    close(level, "plugin");
+  }
+
+  void build(unsigned int level, unsigned int plugin_cnt) {
+    open(level, "build");
+    open(level + 1, "plugins");
+    for (auto i = 0U; i < plugin_cnt; ++i)
+      plugin(level + 2, i);
+    close(level + 1, "plugins");
+    close(level, "build");
+  }
+
+ public:
+  pom_generator(const pom_generator_params& params) : params{params}, rand{params.seed} {}
+
+  string generate() {
+    pom = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    open(0, "project");
+    shuffled(8, [this](unsigned int section) {
+      switch (section) {
+      case 0: leaf(1, "modelVersion", "4.0.0"); break;
+      case 1: leaf(1, "groupId", "com.ourco"); break;
+      case 2: leaf(1, "artifactId", "synthetic"); break;
+      case 3: leaf(1, "version", "1.0-SNAPSHOT"); break;
+      case 4:
+        if (params.property_cnt)
+          properties(1, params.property_cnt);
+        break;
+      case 5:
+        if (params.dependency_cnt) {
+          open(1, "dependencies");
+          for (auto i = 0U; i < params.dependency_cnt; ++i)
+            dependency(2);
+          close(1, "dependencies");
+        }
+        break;
+      case 6:
+        if (params.plugin_cnt)
+          build(1, params.plugin_cnt);
+        break;
+      case 7:
+        if (params.profile_cnt) {
+          open(1, "profiles");
+          for (auto i = 0U; i < params.profile_cnt; ++i) {
+            open(2, "profile");
+            leaf(3, "id", "profile-" + to_string(i));
+            if (params.property_cnt)
+              properties(3, 2);
+            build(3, 1);
+            close(2, "profile");
+          }
+          close(1, "profiles");
+        }
+        break;
+      }
+    });
+    close(0, "project");
+    return pom;
+  }
+};
+}
+
+pom_generator_params
+pom_generator_params::scaled_to(size_t size) const {
+  // sizes are close enough to linear in the section counts to scale from the default mix's size
+  const double scale{static_cast<double>(size) / generate_pom(*this).size()};
+  const auto scaled = [scale](unsigned int cnt) { return max(1U, static_cast<unsigned int>(cnt * scale + 0.5)); };
+  pom_generator_params params{*this};
+  params.dependency_cnt = scaled(dependency_cnt);
+  params.plugin_cnt = scaled(plugin_cnt);
+  params.profile_cnt = scaled(profile_cnt);
+  params.property_cnt = scaled(property_cnt);
+  return params;
+}
+
+string
+generate_pom(const pom_generator_params& params) {
+  return pom_generator{params}.generate();
+}
+}
@@ -0,0 +1,30 @@
+#ifndef POM_GENERATOR_H
+#define POM_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pommade {
+
+// how much of each POM section a synthetic POM gets
+struct pom_generator_params {
+  unsigned int dependency_cnt;
+  unsigned int exclusion_cnt;
+  unsigned int plugin_cnt;
+  unsigned int execution_cnt;
+  unsigned int profile_cnt;
+  unsigned int property_cnt;
+  unsigned int configuration_depth;
+  std::uint32_t seed;
+
+  pom_generator_params() : dependency_cnt{8}, exclusion_cnt{1}, plugin_cnt{2}, execution_cnt{2}, profile_cnt{1}, property_cnt{4}, configuration_depth{3}, seed{1} {}
+
+  // this mix of dependencies, plugins, profiles and properties (with exclusion, execution and depth counts kept), scaled to come out at roughly size bytes
+  pom_generator_params scaled_to(std::size_t size) const;
+};
+
+// a valid, deterministic (for given params) POM with its sections in no particular order, so that rewriting it has real work to do
+std::string generate_pom(const pom_generator_params& params);
+}
+#endif
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/value_semantic.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "dispatch_bench.h"
+#include "pom_batch.h"
+#include "pom_generator.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+#include "xml_graph.h"
+#include "xml_parser.h"
+#include "xml_scanner.h"
+#include "xml_writer.h"
+
+namespace {
+using namespace std;
+using namespace boost::program_options;
+using namespace pommade;
+using namespace xml_graph;
+using namespace xml_parser;
+
+using bench_clock = chrono::steady_clock;
+
+// "50M", "64K" or plain bytes
+size_t
+parse_size(const string& size_spec) {
+  size_t pos;
+  const double size{stod(size_spec, &pos)};
+  const string unit{size_spec.substr(pos)};
+  if (unit.empty())
+    return static_cast<size_t>(size);
+  if (unit == "K" || unit == "k")
+    return static_cast<size_t>(size * 1024);
+  if (unit == "M" || unit == "m")
+    return static_cast<size_t>(size * 1024 * 1024);
+  throw invalid_argument{"bad size '" + size_spec + '\''};
+}
+
+// runs fn until min_secs have passed (at least once), returning the seconds per run
+template <typename Fn>
+double
+time_runs(double min_secs, Fn fn) {
+  unsigned int run_cnt{};
+  const auto start = bench_clock::now();
+  double secs;
+  do {
+    fn();
+    ++run_cnt;
+    secs = chrono::duration<double>(bench_clock::now() - start).count();
+  } while (secs < min_secs);
+  return secs / run_cnt;
+}
+
+bool
+same_text(const xml_text& text, const xml_text& that_text) {
+  return static_cast<bool>(text) == static_cast<bool>(that_text) && text == that_text;
+}
+
+// the first node (in document order) where two documents differ, or nullptr if they're identical
+const xml_node*
+first_difference(const xml_node* root, const xml_node* that_root) {
+  const unsigned int node_cnt{min(root->get_span(), that_root->get_span())};
+  for (unsigned int i{}; i < node_cnt; ++i) {
+    const xml_node& node = root[i];
+    const xml_node& that_node = that_root[i];
+    if (node.get_span() != that_node.get_span() || node.tree().node_cnt() != that_node.tree().node_cnt() || node.lineno != that_node.lineno || node.level != that_node.level || node.name != that_node.name || !same_text(node.comment, that_node.comment) || !same_text(node.get_content(), that_node.get_content()))
+      return &node;
+  }
+  return root->get_span() == that_root->get_span() ? nullptr : root + node_cnt;
+}
+
+enum class conformance { identical, fallback, different };
+
+// parses with xml_scanner alone and with Xerces alone; a document the scanner gives up on is fine, as long as it's the only
+// difference
+conformance
+check_conformance(const char* buf, size_t len, const char* system_id, ostream& err) {
+  default_xml_doc_handler doc_handler;
+  xml_scanner scanner;
+  if (!scanner.scan(buf, len, doc_handler))
+    return conformance::fallback;
+  const xml_doc<xml_node> native_doc{static_cast<xml_doc_handler&>(doc_handler).doc()};
+  xml_doc_parser doc_parser{doc_handler, xml_parser_backend::xerces};
+  const xml_doc<xml_node> xerces_doc{doc_parser.parse_doc(buf, len, system_id)};
+  if (const xml_node* const node = first_difference(native_doc.get(), xerces_doc.get())) {
+    err << system_id << ':' << node->lineno << ": native and Xerces documents differ at '" << node->name << '\'' << endl;
+    return conformance::different;
+  }
+  return conformance::identical;
+}
+
+bool
+check_corpus_conformance(const vector<string>& files) {
+  size_t cnts[3]{};
+  for (const auto& file : files) {
+    try {
+      const xml_doc_buffer buffer{xml_doc_buffer::map_file(file.c_str())};
+      const conformance result{check_conformance(buffer.data(), buffer.size(), file.c_str(), cerr)};
+      ++cnts[static_cast<int>(result)];
+      if (result == conformance::fallback)
+        cout << file << ": left to Xerces" << endl;
+    } catch (const exception& e) {
+      cerr << file << ": " << e.what() << endl;
+      ++cnts[static_cast<int>(conformance::different)];
+    }
+  }
+  cout << cnts[0] << " identical, " << cnts[1] << " left to Xerces, " << cnts[2] << " different" << endl;
+  return !cnts[2];
+}
+
+struct phase_result {
+  double secs;
+  size_t bytes;
+};
+
+void
+print_phase(const phase_result& result, size_t node_cnt) {
+  cout << setw(16) << fixed << setprecision(1) << result.bytes / result.secs / (1024 * 1024) << setw(18) << setprecision(0) << node_cnt / result.secs;
+}
+
+// the elements in a serialized document (however they came to be written: spliced source included)
+size_t
+written_node_cnt(const xml_writer& writer) {
+  size_t node_cnt{};
+  for (size_t i{1}; i < writer.size(); ++i) {
+    if (writer.data()[i - 1] == '<' && writer.data()[i] != '/' && writer.data()[i] != '!' && writer.data()[i] != '?')
+      ++node_cnt;
+  }
+  return node_cnt;
+}
+
+void
+bench_pom(const string& pom, double min_secs, xml_parser_backend backend, const vector<pom_artifact_matcher>& preferred_artifacts) {
+  if (check_conformance(pom.data(), pom.size(), "synthetic", cerr) != conformance::identical)
+    cerr << "synthetic POM of " << pom.size() << " bytes isn't handled natively" << endl;
+  default_xml_doc_handler doc_handler;
+  xml_doc_parser doc_parser{doc_handler, backend};
+  pom_rewriter rewriter{preferred_artifacts};
+  xml_writer writer;
+
+  xml_doc<xml_node> doc;
+  const phase_result parse{time_runs(min_secs, [&]() { doc = doc_parser.parse_doc(pom.data(), pom.size(), "synthetic"); }), pom.size()};
+  const size_t node_cnt{doc.get()->get_span()};
+
+  // every rewrite allocates from the document's arena, so a fresh document is parsed (untimed) once it has grown to about 64 times the POM
+  size_t rewrite_cnt{};
+  double rewrite_secs{};
+  const auto rewrite_start = bench_clock::now();
+  do {
+    if (++rewrite_cnt % 64 == 0)
+      doc = doc_parser.parse_doc(pom.data(), pom.size(), "synthetic");
+    const auto start = bench_clock::now();
+    rewriter.rewrite_pom(doc.get());
+    rewrite_secs += chrono::duration<double>(bench_clock::now() - start).count();
+  } while (chrono::duration<double>(bench_clock::now() - rewrite_start).count() < min_secs);
+  const phase_result rewrite{rewrite_secs / rewrite_cnt, pom.size()};
+
+  const pom_xml_node rw_pom{rewriter.rewrite_pom(doc.get())};
+  const phase_result serialize{time_runs(min_secs, [&]() {
+                                 writer.clear();
+                                 writer << rw_pom;
+                               }),
+                               writer.size()};
+
+  cout << setw(10) << pom.size() << setw(10) << node_cnt;
+  print_phase(parse, node_cnt);
+  print_phase(rewrite, node_cnt);
+  print_phase(serialize, written_node_cnt(writer));
+  cout << endl;
+}
+
+// nesting of the configuration block in the deep POM checked by check_scaling: its output grows with the square of the depth (for
+// the indentation), so this is about as deep as is quick to write
+const unsigned int scaling_depth = 4096;
+
+struct scaling_result {
+  size_t line_cnt;
+  size_t byte_cnt;
+  double secs;
+  // the document's arena (which the rewrite allocates from too) and the serialized rewrite
+  size_t mem_bytes;
+  // elements whose source is written as it is, rather than being rewritten
+  size_t spliced_cnt;
+};
+
+// parses, rewrites and serializes a POM (best of three runs, each into a fresh document), checking that the line number of its last
+// element made it through unwrapped
+scaling_result
+measure_scaling(const string& pom, xml_parser_backend backend, const vector<pom_artifact_matcher>& preferred_artifacts) {
+  default_xml_doc_handler doc_handler;
+  xml_doc_parser doc_parser{doc_handler, backend};
+  pom_rewriter rewriter{preferred_artifacts};
+  xml_writer writer;
+  scaling_result result{static_cast<size_t>(count(pom.cbegin(), pom.cend(), '\n')), pom.size(), 0, 0, 0};
+  // the last element is the last start tag's
+  size_t last_start{pom.size()};
+  while (last_start-- > 0 && !(pom[last_start] == '<' && last_start + 1 < pom.size() && isalpha(static_cast<unsigned char>(pom[last_start + 1]))))
+    ;
+  const size_t last_lineno{1 + static_cast<size_t>(count(pom.cbegin(), pom.cbegin() + static_cast<ptrdiff_t>(last_start), '\n'))};
+  for (auto run = 0U; run < 3; ++run) {
+    const auto start = bench_clock::now();
+    const xml_doc<xml_node> doc{doc_parser.parse_doc(pom.data(), pom.size(), "synthetic")};
+    const pom_xml_node rw_pom{rewriter.rewrite_pom(doc.get())};
+    writer.clear();
+    writer << rw_pom;
+    const double secs{chrono::duration<double>(bench_clock::now() - start).count()};
+    if (!run || secs < result.secs)
+      result.secs = secs;
+    result.mem_bytes = doc->get_arena().allocated_size() + writer.size();
+    result.spliced_cnt = static_cast<size_t>(count_if(doc.get(), doc.get() + doc->get_span(), [](const xml_node& node) { return static_cast<bool>(node.get_source()); }));
+    if (doc.get()[doc->get_span() - 1].lineno != last_lineno)
+      throw runtime_error{"last element at line " + to_string(doc.get()[doc->get_span() - 1].lineno) + " rather than " + to_string(last_lineno)};
+  }
+  return result;
+}
+
+// times synthetic POMs of an eighth, a quarter, half and all of max_line_cnt lines, failing unless the time and memory per line of
+// the largest are within a small factor of the smallest's; then one with a configuration block nested scaling_depth deep, both
+// spliced as written and not (failing if it is)
+bool
+check_scaling(unsigned int max_line_cnt, const pom_generator_params& params, xml_parser_backend backend, const vector<pom_artifact_matcher>& preferred_artifacts) {
+  const string default_pom{generate_pom(params)};
+  const double bytes_per_line{static_cast<double>(default_pom.size()) / count(default_pom.cbegin(), default_pom.cend(), '\n')};
+  cout << setw(10) << "lines" << setw(12) << "bytes" << setw(12) << "ms" << setw(12) << "ns/line" << setw(16) << "mem bytes/line" << endl;
+  vector<scaling_result> results;
+  for (const unsigned int divisor : {8U, 4U, 2U, 1U}) {
+    const scaling_result result{measure_scaling(generate_pom(params.scaled_to(static_cast<size_t>(max_line_cnt / divisor * bytes_per_line))), backend, preferred_artifacts)};
+    cout << setw(10) << result.line_cnt << setw(12) << result.byte_cnt << setw(12) << fixed << setprecision(1) << result.secs * 1e3 << setw(12) << result.secs * 1e9 / result.line_cnt << setw(16) << static_cast<double>(result.mem_bytes) / result.line_cnt << endl;
+    results.push_back(result);
+  }
+  // time is allowed more slack than memory, for the noise in timing
+  const double time_growth{results.back().secs / results.back().line_cnt / (results.front().secs / results.front().line_cnt)};
+  const double mem_growth{static_cast<double>(results.back().mem_bytes) / results.back().line_cnt / (static_cast<double>(results.front().mem_bytes) / results.front().line_cnt)};
+  const bool linear{time_growth < 2 && mem_growth < 1.5};
+  cout << "per line, " << setprecision(2) << time_growth << "x the time and " << mem_growth << "x the memory at " << static_cast<double>(results.back().line_cnt) / results.front().line_cnt << "x the lines: " << (linear ? "linear" : "NOT linear") << endl;
+
+  pom_generator_params deep_params{params};
+  deep_params.configuration_depth = scaling_depth;
+  deep_params.plugin_cnt = 1;
+  const scaling_result deep_result{measure_scaling(generate_pom(deep_params), backend, preferred_artifacts)};
+  cout << "configuration nested " << scaling_depth << " deep: " << setprecision(1) << deep_result.secs * 1e3 << " ms" << endl;
+  // a UTF-8 configuration is spliced as written, so the same again declared ISO-8859-1 (which the ASCII it is stays valid in) for
+  // one that the rewriter copies and the serializer writes element by element
+  string unspliced_pom{generate_pom(deep_params)};
+  unspliced_pom.replace(unspliced_pom.find("UTF-8"), 5, "ISO-8859-1");
+  const scaling_result unspliced_result{measure_scaling(unspliced_pom, backend, preferred_artifacts)};
+  cout << "configuration nested " << scaling_depth << " deep, not spliced: " << unspliced_result.secs * 1e3 << " ms" << (unspliced_result.spliced_cnt ? " (but spliced after all)" : "") << endl;
+  return linear && !unspliced_result.spliced_cnt;
+}
+}
+
+int
+main(int argc, const char* argv[]) {
+  ostringstream opt_headers_oss;
+  opt_headers_oss << "pommade_bench" << endl << "usage: pommade_bench [options] [size...] | pommade_bench --conform file|@listfile... | pommade_bench --scaling [lines] | pommade_bench --dispatch [size...]" << endl << "Times parsing, rewriting and serializing synthetic POMs of each size (default: 1K to 50M)" << endl << "Options";
+  options_description opts_desc(opt_headers_oss.str());
+  const pom_generator_params defaults;
+  opts_desc.add_options()("help,h", "this help message")("min-time,t", value<double>()->default_value(0.5), "time each phase for at least this many seconds")("seed", value<unsigned int>()->default_value(1), "synthetic POM seed")("dependencies", value<unsigned int>()->default_value(defaults.dependency_cnt), "dependencies in the mix scaled to each size")("plugins", value<unsigned int>()->default_value(defaults.plugin_cnt), "plugins in the mix scaled to each size")("profiles", value<unsigned int>()->default_value(defaults.profile_cnt), "profiles in the mix scaled to each size")("properties", value<unsigned int>()->default_value(defaults.property_cnt), "properties in the mix scaled to each size")("exclusions", value<unsigned int>()->default_value(1), "exclusions per dependency")("executions", value<unsigned int>()->default_value(2), "executions per plugin")("depth", value<unsigned int>()->default_value(3), "configuration block depth")("preferred-artifact,p", value<vector<string>>()->composing(), "groupId[:artifactId], where a groupId may end in '*' and an artifactId hold '*' anywhere")("generate", "write the synthetic POM of the (one) size to standard output instead")("parser", value<string>()->default_value("native"), "'native' or 'xerces'")("conform", "check that the native parser builds the same documents as Xerces from the files given (instead of sizes)")("scaling", value<unsigned int>()->implicit_value(1000000), "check that time and memory grow linearly with POMs of up to this many lines (instead of sizes)")("dispatch", "time the rewriter's per-node dispatch through std::functions in a map (as it was) and through constexpr tables (as it is) over dependency-heavy POMs of each size");
+  options_description hidden_opts_desc;
+  hidden_opts_desc.add_options()("arg", value<vector<string>>(), "");
+  options_description all_opts_desc;
+  all_opts_desc.add(opts_desc).add(hidden_opts_desc);
+  positional_options_description positional_opts_desc;
+  positional_opts_desc.add("arg", -1);
+
+  variables_map var_map;
+  vector<size_t> sizes;
+  vector<pom_artifact_matcher> preferred_artifacts;
+  try {
+    store(command_line_parser(argc, argv).options(all_opts_desc).positional(positional_opts_desc).run(), var_map);
+    notify(var_map);
+    if (var_map.count("arg") && !var_map.count("conform")) {
+      for (const auto& size_spec : var_map["arg"].as<vector<string>>())
+        sizes.push_back(parse_size(size_spec));
+    } else
+      sizes = {1024, 16 * 1024, 256 * 1024, 1024 * 1024, 8 * 1024 * 1024, 50 * 1024 * 1024};
+    if (var_map.count("preferred-artifact")) {
+      for (const auto& spec : var_map["preferred-artifact"].as<vector<string>>())
+        preferred_artifacts.push_back(pom_artifact_matcher::parse(spec));
+    }
+  } catch (const exception& e) {
+    cerr << "can't parse command line: " << e.what() << endl;
+    return 1;
+  }
+  if (var_map.count("help")) {
+    cout << opts_desc;
+    return 0;
+  }
+
+  pom_generator_params params;
+  params.seed = var_map["seed"].as<unsigned int>();
+  params.dependency_cnt = var_map["dependencies"].as<unsigned int>();
+  params.exclusion_cnt = var_map["exclusions"].as<unsigned int>();
+  params.plugin_cnt = var_map["plugins"].as<unsigned int>();
+  params.execution_cnt = var_map["executions"].as<unsigned int>();
+  params.profile_cnt = var_map["profiles"].as<unsigned int>();
+  params.property_cnt = var_map["properties"].as<unsigned int>();
+  params.configuration_depth = var_map["depth"].as<unsigned int>();
+  if (var_map.count("generate")) {
+    if (sizes.size() != 1) {
+      cerr << "--generate takes exactly one size" << endl;
+      return 1;
+    }
+    cout << generate_pom(params.scaled_to(sizes.front()));
+    return 0;
+  }
+
+  const string parser{var_map["parser"].as<string>()};
+  if (parser != "native" && parser != "xerces") {
+    cerr << "invalid parser '" << parser << "' (expected 'native' or 'xerces')" << endl;
+    return 1;
+  }
+
+  const xml_platform platform;
+  if (var_map.count("conform")) {
+    vector<string> files;
+    for (const auto& file_arg : var_map.count("arg") ? var_map["arg"].as<vector<string>>() : vector<string>{}) {
+      if (file_arg.size() > 1 && file_arg[0] == '@') {
+        ifstream ifs{file_arg.substr(1)};
+        const vector<string> listed_files{read_file_list(ifs)};
+        files.insert(files.end(), listed_files.cbegin(), listed_files.cend());
+      } else
+        files.push_back(file_arg);
+    }
+    return check_corpus_conformance(files) ? 0 : 1;
+  }
+  if (var_map.count("scaling")) {
+    try {
+      return check_scaling(var_map["scaling"].as<unsigned int>(), params, parser == "native" ? xml_parser_backend::native : xml_parser_backend::xerces, preferred_artifacts) ? 0 : 1;
+    } catch (const exception& e) {
+      cerr << e.what() << endl;
+      return 1;
+    }
+  }
+  if (var_map.count("dispatch")) {
+    // unless the mix is given, nearly all dependencies (each with its exclusions), for the most dispatches per byte
+    pom_generator_params dispatch_params{params};
+    if (var_map["dependencies"].defaulted())
+      dispatch_params.dependency_cnt = 64;
+    if (var_map["plugins"].defaulted())
+      dispatch_params.plugin_cnt = 1;
+    if (var_map["profiles"].defaulted())
+      dispatch_params.profile_cnt = 1;
+    if (var_map["properties"].defaulted())
+      dispatch_params.property_cnt = 1;
+    cout << setw(10) << "bytes" << setw(10) << "calls" << setw(16) << "map ns/call" << setw(16) << "table ns/call" << setw(11) << "speedup" << endl;
+    for (const auto size : sizes)
+      bench_dispatch(generate_pom(dispatch_params.scaled_to(size)), var_map["min-time"].as<double>(), parser == "native" ? xml_parser_backend::native : xml_parser_backend::xerces);
+    return 0;
+  }
+  cout << setw(10) << "bytes" << setw(10) << "nodes";
+  for (const auto phase : {"parse", "rewrite", "serialize"})
+    cout << setw(16) << string{phase} + " MB/s" << setw(18) << string{phase} + " nodes/s";
+  cout << endl;
+  for (const auto size : sizes)
+    bench_pom(generate_pom(params.scaled_to(size)), var_map["min-time"].as<double>(), parser == "native" ? xml_parser_backend::native : xml_parser_backend::xerces, preferred_artifacts);
+  return 0;
+}
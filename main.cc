@@ -1,19 +1,24 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
 #include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/parsers.hpp>
 #include <boost/program_options/value_semantic.hpp>
 #include <boost/program_options/variables_map.hpp>
 
-#include <xercesc/sax/SAXParseException.hpp>
-#include <xercesc/util/XMLException.hpp>
-
+#include "pom_batch.h"
+#include "pom_index.h"
+#include "pom_reactor.h"
+#include "pom_stats.h"
+#include "pom_watch.h"
 #include "rewrite_pom.h"
 #include "xml_parser.h"
 
@@ -21,7 +26,6 @@ namespace {
 using namespace std;
 using namespace boost::filesystem;
 using namespace boost::program_options;
-using namespace xercesc_3_1;
 using namespace pommade;
 using namespace xml_parser;
 
@@ -32,19 +36,57 @@ parse_pom_artifact_matchers(const vector<string>& pom_artifact_matcher_specs) {
     pom_artifacts.push_back(pom_artifact_matcher::parse(pom_artifact_matcher_spec));
   return pom_artifacts;
 }
+
+// the files listed in list ('-': standard input), one per delim-terminated line
+vector<string>
+read_files_from(const string& list, char delim) {
+  if (list == stdin_file)
+    return read_file_list(cin, delim);
+  ifstream ifs{list};
+  if (!ifs)
+    throw invalid_argument{"can't open file list '" + list + '\''};
+  return read_file_list(ifs, delim);
+}
+
+// expands '@listfile' arguments into the (newline-separated) files they list
+vector<string>
+expand_file_args(const vector<string>& file_args) {
+  vector<string> files;
+  for (const auto& file_arg : file_args) {
+    if (file_arg.size() > 1 && file_arg[0] == '@') {
+      const vector<string> listed_files{read_files_from(file_arg.substr(1), '\n')};
+      files.insert(files.end(), listed_files.cbegin(), listed_files.cend());
+    } else
+      files.push_back(file_arg);
+  }
+  return files;
+}
+
+string
+default_cache_dir() {
+  if (const char* const xdg_cache_home = getenv("XDG_CACHE_HOME")) {
+    if (*xdg_cache_home)
+      return (path{xdg_cache_home} / "pommade").string();
+  }
+  if (const char* const home = getenv("HOME")) {
+    if (*home)
+      return (path{home} / ".cache" / "pommade").string();
+  }
+  return string{};
+}
 }
 
 int
 main(int argc, const char* argv[]) {
   // gather options
   ostringstream opt_headers_oss;
-  const char* const usage = "usage: pommade [options] file";
+  const char* const usage = "usage: pommade [options] file|-|@listfile... | pommade [options] --files-from list [-0] | pommade [options] --reactor dir|pom.xml... | pommade [options] --watch dir";
   opt_headers_oss << "pommade" << endl << usage << endl << "Command-line options";
   options_description cmd_line_opts_desc(opt_headers_oss.str());
-  cmd_line_opts_desc.add_options()("help,h", "this help message")("config-file,c", value<string>(), "configuration file");
+  cmd_line_opts_desc.add_options()("help,h", "this help message")("config-file,c", value<string>(), "configuration file")("jobs,j", value<unsigned int>()->default_value(1), "rewrite files on this many threads (0: one per core)")("in-place,i", "replace each file with its rewrite instead of writing to standard output")("files-from", value<string>(), "also rewrite the files listed in this file ('-': standard input), one per line")("null,0", "--files-from's list is NUL-separated (as git ls-files -z and find -print0 write it)")("check", "write nothing, but fail (naming the first differing line) if any file differs from its rewrite")("cache", "remember which files are canonical across runs, in $XDG_CACHE_HOME/pommade or ~/.cache/pommade (off by default)")("cache-dir", value<string>(), "remember which files are canonical across runs, here (implies --cache)")("no-cache", "neither consult nor update the cache, overriding --cache and --cache-dir")("version-conflicts", "write nothing but the artifacts the files declare dependencies on with differing versions, and where (failing if there are any)")("reactor", "rewrite each given POM (or a directory's pom.xml) and every module below it, following <module> paths")("watch", value<string>(), "keep running, rewriting in place each pom.xml below this directory as it's saved")("parser", value<string>()->default_value("native"), "'native' (with Xerces for what it can't handle) or 'xerces'")("stream", "rewrite each file as Xerces parses it, holding one section at a time rather than the whole document (a file whose sections are out of order is rewritten whole); not with --parser native")("stats", "report what each phase cost, per file and in total, to standard error")("stats-format", value<string>(), "'table' (the default) or 'json'; implies --stats");
 
   options_description config_file_opts_desc("Configuration options");
-  config_file_opts_desc.add_options()("preferred-artifact,p", value<vector<string>>()->composing(), "groupId[:artifactId]");
+  config_file_opts_desc.add_options()("preferred-artifact,p", value<vector<string>>()->composing(), "groupId[:artifactId], where a groupId may end in '*' and an artifactId hold '*' anywhere");
   cmd_line_opts_desc.add(config_file_opts_desc);
 
   variables_map var_map;
@@ -75,15 +117,48 @@ main(int argc, const char* argv[]) {
   }
   notify(var_map);
 
-  // validate file
-  if (unrecognized_opts.empty()) {
+  // validate files
+  const bool watch{var_map.count("watch") > 0};
+  const bool files_from{var_map.count("files-from") > 0};
+  if (watch && (files_from || !unrecognized_opts.empty())) {
+    cerr << "no file may be set with --watch" << endl;
+    return 1;
+  }
+  if (!watch && !files_from && unrecognized_opts.empty()) {
     cerr << "no file set" << endl;
     return 1;
-  } else if (unrecognized_opts.size() != 1) {
-    cerr << "unrecognized argument(s) after file '" << unrecognized_opts[0] << '\'' << endl;
+  }
+  vector<string> files;
+  try {
+    files = expand_file_args(unrecognized_opts);
+    if (files_from) {
+      const vector<string> listed_files{read_files_from(var_map["files-from"].as<string>(), var_map.count("null") ? '\0' : '\n')};
+      files.insert(files.end(), listed_files.cbegin(), listed_files.cend());
+    }
+  } catch (const invalid_argument& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  // standard input is either a list or the one POM read from it
+  const auto stdin_reads = count(files.cbegin(), files.cend(), stdin_file) + count(unrecognized_opts.cbegin(), unrecognized_opts.cend(), string{"@"} + stdin_file) + (files_from && var_map["files-from"].as<string>() == stdin_file);
+  if (stdin_reads > 1) {
+    cerr << "standard input can only be read once" << endl;
+    return 1;
+  }
+  const bool reactor{var_map.count("reactor") > 0};
+  if (reactor && watch) {
+    cerr << "--reactor and --watch are mutually exclusive" << endl;
+    return 1;
+  }
+  const bool version_conflicts{var_map.count("version-conflicts") > 0};
+  if (version_conflicts && (reactor || watch)) {
+    cerr << "--version-conflicts is mutually exclusive with --reactor and --watch" << endl;
+    return 1;
+  }
+  if (reactor && count(files.cbegin(), files.cend(), stdin_file)) {
+    cerr << "standard input has no modules to follow with --reactor" << endl;
     return 1;
   }
-  const char* const file = unrecognized_opts[0].c_str();
 
   // option validation: preferred artifacts
   vector<pom_artifact_matcher> preferred_artifacts;
@@ -96,17 +171,71 @@ main(int argc, const char* argv[]) {
     }
   }
 
-  try {
-    default_xml_doc_handler doc_handler;
-    cout << pom_rewriter{preferred_artifacts}.rewrite_pom(xml_doc_parser{doc_handler}.parse_doc(file).get());
-  } catch (const XMLException& e) {
-    cerr << "caught XMLException: " << xmlstring{e.getMessage()} << endl;
+  // option validation: output mode
+  pom_batch_options batch_options;
+  batch_options.jobs = var_map["jobs"].as<unsigned int>();
+  batch_options.in_place = var_map.count("in-place");
+  batch_options.check = var_map.count("check");
+  if (batch_options.in_place && batch_options.check) {
+    cerr << "--in-place and --check are mutually exclusive" << endl;
     return 1;
-  } catch (const SAXParseException& e) {
-    cerr << "caught SAXParseException: " << xmlstring{e.getMessage()} << endl;
+  }
+  if (batch_options.in_place && count(files.cbegin(), files.cend(), stdin_file)) {
+    cerr << "standard input can't be rewritten in place" << endl;
+    return 1;
+  }
+  if (version_conflicts && (batch_options.in_place || batch_options.check)) {
+    cerr << "--version-conflicts is mutually exclusive with --in-place and --check" << endl;
     return 1;
-  } catch (...) {
-    cerr << "caught exception" << endl;
+  }
+  if (watch && batch_options.check) {
+    cerr << "--watch and --check are mutually exclusive" << endl;
+    return 1;
+  }
+  const string parser{var_map["parser"].as<string>()};
+  if (parser != "native" && parser != "xerces") {
+    cerr << "invalid parser '" << parser << "' (expected 'native' or 'xerces')" << endl;
+    return 1;
+  }
+  batch_options.parser_backend = parser == "native" ? xml_parser_backend::native : xml_parser_backend::xerces;
+  batch_options.stream = var_map.count("stream");
+  // streaming parses with Xerces, so only --parser xerces (also used for a file that's rewritten whole after all) is honoured
+  if (batch_options.stream && !var_map["parser"].defaulted() && batch_options.parser_backend == xml_parser_backend::native) {
+    cerr << "--stream parses with Xerces: it can't be used with --parser native" << endl;
     return 1;
   }
+  const string stats_format{var_map.count("stats-format") ? var_map["stats-format"].as<string>() : var_map.count("stats") ? "table" : ""};
+  if (!stats_format.empty() && stats_format != "table" && stats_format != "json") {
+    cerr << "invalid stats format '" << stats_format << "' (expected 'table' or 'json')" << endl;
+    return 1;
+  }
+  if (watch && !stats_format.empty()) {
+    cerr << "--watch and --stats are mutually exclusive" << endl;
+    return 1;
+  }
+  if (version_conflicts && !stats_format.empty()) {
+    cerr << "--version-conflicts and --stats are mutually exclusive" << endl;
+    return 1;
+  }
+  if (!var_map.count("no-cache") && (var_map.count("cache") || var_map.count("cache-dir"))) {
+    batch_options.cache_dir = var_map.count("cache-dir") ? var_map["cache-dir"].as<string>() : default_cache_dir();
+    if (batch_options.cache_dir.empty()) {
+      cerr << "no directory for --cache: neither XDG_CACHE_HOME nor HOME is set (give one with --cache-dir)" << endl;
+      return 1;
+    }
+  }
+
+  const xml_platform platform;
+  if (watch)
+    return watch_tree(var_map["watch"].as<string>(), preferred_artifacts, batch_options, cout, cerr) ? 0 : 1;
+  if (version_conflicts)
+    return report_version_conflicts(files, batch_options, cout, cerr) ? 0 : 1;
+  // one failed file doesn't abort the batch, but does fail the run
+  pom_stats stats;
+  const bool ok{reactor ? rewrite_reactor(files, preferred_artifacts, batch_options, cout, cerr, stats_format.empty() ? nullptr : &stats) : rewrite_files(files, preferred_artifacts, batch_options, cout, cerr, stats_format.empty() ? nullptr : &stats)};
+  if (stats_format == "table")
+    stats.write_table(cerr);
+  else if (stats_format == "json")
+    stats.write_json(cerr);
+  return ok ? 0 : 1;
 }
@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/system/error_code.hpp>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/util/XMLException.hpp>
+
+#include "pom_batch.h"
+#include "pom_cache.h"
+#include "pom_stats.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+#include "xml_parser.h"
+
+namespace pommade {
+using namespace std;
+using namespace xercesc_3_1;
+using namespace xml_parser;
+
+namespace {
+// output of a streamed rewrite is handed on in chunks of at least this size
+const size_t stream_flush_len = 64 * 1024;
+
+// a temporary file (gone once closed) that a streamed rewrite's output waits in until the document has turned out to be in order
+using spool_file = unique_ptr<FILE, int (*)(FILE*)>;
+
+spool_file
+open_spool() {
+  spool_file spool{tmpfile(), fclose};
+  if (!spool)
+    throw runtime_error{string{"can't create temporary file for streamed output: "} + strerror(errno)};
+  return spool;
+}
+
+void
+write_spool(FILE* spool, const char* chars, size_t len) {
+  if (fwrite(chars, 1, len, spool) != len)
+    throw runtime_error{string{"can't write streamed output: "} + strerror(errno)};
+}
+
+void
+copy_spool(FILE* spool, ostream& os) {
+  rewind(spool);
+  char buf[stream_flush_len];
+  for (size_t len; (len = fread(buf, 1, sizeof buf, spool));)
+    os.write(buf, static_cast<streamsize>(len));
+  if (ferror(spool))
+    throw runtime_error{"can't read streamed output back"};
+}
+
+#ifndef _WIN32
+string
+errno_message(const string& what) {
+  return what + ": " + strerror(errno);
+}
+#endif
+
+void
+report_not_canonical(const string& file, const xml_doc_buffer& buffer, size_t mismatch_offset, ostream& err) {
+  err << file << ':' << 1 + count(buffer.data(), buffer.data() + mismatch_offset, '\n') << ": not in canonical form" << endl;
+}
+
+// a temporary file next to the one it's to replace, so that rename() replaces it atomically: commit() renames it over the original
+// (giving it the original's permissions and owner, and flushing it to disk first), otherwise it's removed; a symlink is followed to
+// the file it names, which is what's replaced, so that the link stays a link
+class replacement_file {
+  const string& file;
+#ifdef _WIN32
+  boost::filesystem::path target;
+  boost::filesystem::path tmp_path;
+  ofstream tmp_os;
+  bool committed;
+#else
+  string target;
+  mode_t mode;
+  uid_t uid;
+  gid_t gid;
+  string tmp_file;
+  int fd;
+#endif
+
+ public:
+  explicit replacement_file(const string& file);
+  ~replacement_file();
+  replacement_file(const replacement_file&) = delete;
+  replacement_file& operator=(const replacement_file&) = delete;
+
+  string temporary_file() const;
+  void write(const char* chars, size_t len);
+  void commit();
+};
+
+#ifdef _WIN32
+// there are no owners or fsync() to speak of, and boost's rename() replaces an existing file
+replacement_file::replacement_file(const string& file) : file{file}, committed{} {
+  boost::system::error_code ec;
+  target = boost::filesystem::canonical(file, ec);
+  if (ec)
+    throw runtime_error{"can't resolve '" + file + "': " + ec.message()};
+  tmp_path = boost::filesystem::unique_path(target.string() + ".%%%%%%");
+  tmp_os.open(tmp_path.string(), ios::binary);
+  if (!tmp_os)
+    throw runtime_error{"can't create temporary file for '" + file + '\''};
+}
+
+replacement_file::~replacement_file() {
+  if (!committed) {
+    tmp_os.close();
+    boost::system::error_code ec;
+    boost::filesystem::remove(tmp_path, ec);
+  }
+}
+
+string
+replacement_file::temporary_file() const {
+  return tmp_path.string();
+}
+
+void
+replacement_file::write(const char* chars, size_t len) {
+  if (!tmp_os.write(chars, static_cast<streamsize>(len)))
+    throw runtime_error{"can't replace '" + file + '\''};
+}
+
+void
+replacement_file::commit() {
+  tmp_os.close();
+  if (!tmp_os)
+    throw runtime_error{"can't replace '" + file + '\''};
+  boost::system::error_code ec;
+  const boost::filesystem::file_status target_status{boost::filesystem::status(target, ec)};
+  if (!ec)
+    boost::filesystem::permissions(tmp_path, target_status.permissions(), ec);
+  if (!ec)
+    boost::filesystem::rename(tmp_path, target, ec);
+  if (ec)
+    throw runtime_error{"can't replace '" + file + "': " + ec.message()};
+  committed = true;
+}
+#else
+replacement_file::replacement_file(const string& file) : file{file}, fd{-1} {
+  char* const resolved{realpath(file.c_str(), nullptr)};
+  if (!resolved)
+    throw runtime_error{errno_message("can't resolve '" + file + '\'')};
+  target = resolved;
+  free(resolved);
+  struct stat target_stat;
+  if (stat(target.c_str(), &target_stat))
+    throw runtime_error{errno_message("can't stat '" + file + '\'')};
+  mode = target_stat.st_mode & 07777;
+  uid = target_stat.st_uid;
+  gid = target_stat.st_gid;
+  tmp_file = target + ".XXXXXX";
+  fd = mkstemp(&tmp_file[0]);
+  if (fd < 0) {
+    tmp_file.clear();
+    throw runtime_error{errno_message("can't create temporary file for '" + file + '\'')};
+  }
+}
+
+replacement_file::~replacement_file() {
+  if (fd >= 0)
+    close(fd);
+  if (!tmp_file.empty())
+    unlink(tmp_file.c_str());
+}
+
+string
+replacement_file::temporary_file() const {
+  return tmp_file;
+}
+
+// retries short writes
+void
+replacement_file::write(const char* chars, size_t len) {
+  for (size_t written{}; written < len;) {
+    const ssize_t n{::write(fd, chars + written, len - written)};
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw runtime_error{errno_message("can't replace '" + file + '\'')};
+    }
+    written += static_cast<size_t>(n);
+  }
+}
+
+// the owner is only changed (which takes privileges) if the temporary file didn't get it anyway, and before the mode, as a change
+// of owner may clear set-user-ID and set-group-ID bits
+void
+replacement_file::commit() {
+  struct stat tmp_stat;
+  bool ok{!fstat(fd, &tmp_stat)};
+  if (ok && (tmp_stat.st_uid != uid || tmp_stat.st_gid != gid))
+    ok = !fchown(fd, uid, gid);
+  ok = ok && !fchmod(fd, mode) && !fsync(fd);
+  ok = !close(fd) && ok;
+  fd = -1;
+  if (!ok || rename(tmp_file.c_str(), target.c_str()))
+    throw runtime_error{errno_message("can't replace '" + file + '\'')};
+  tmp_file.clear();
+}
+#endif
+}
+
+void
+pom_batch_rewriter::replace_file(const string& file) const {
+  replacement_file replacement{file};
+  replacement.write(writer.data(), writer.size());
+  if (may_replace(file, replacement.temporary_file()))
+    replacement.commit();
+}
+
+bool
+pom_batch_rewriter::rewrite_file(const string& file, ostream& os, ostream& err, pom_doc_stats* doc_stats) {
+  // timing a phase costs a few clock reads per file, so it's done whether or not anyone asked
+  pom_doc_stats unreported_stats;
+  pom_doc_stats& stats{doc_stats ? *doc_stats : unreported_stats};
+  stats.file = file;
+  // with the file's other errors, rather than straight to std::cerr from whichever thread is parsing it
+  const xml_diagnostics_redirect diagnostics_redirect{err};
+  try {
+    pom_phase_timer parse_timer{stats.parse};
+    const xml_doc_buffer buffer{file == stdin_file ? xml_doc_buffer::read(cin) : options.read_files ? xml_doc_buffer::read_file(file.c_str()) : xml_doc_buffer::map_file(file.c_str())};
+    stats.bytes_in = buffer.size();
+    const pom_cache::key cache_key{cache ? cache->make_key(buffer.data(), buffer.size()) : pom_cache::key{}};
+    if (cache && cache->is_canonical(cache_key)) {
+      stats.cached = true;
+      if (options.list_modules)
+        rewriter.rewrite_pom(doc_parser.parse_doc(buffer.data(), buffer.size(), file.c_str()).get());
+      parse_timer.stop();
+      const pom_phase_timer serialize_timer{stats.serialize};
+      if (!options.check && !options.in_place) {
+        os.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        stats.bytes_out = buffer.size();
+      }
+      return true;
+    }
+    parse_timer.stop();
+    if (stream_rewriter && stream_doc(file, buffer, cache_key, os, stats))
+      return true;
+    return rewrite_doc(file, buffer, cache_key, os, err, stats);
+  } catch (const XMLException& e) {
+    err << file << ": caught XMLException: " << xmlstring{e.getMessage()} << endl;
+  } catch (const SAXParseException& e) {
+    err << file << ": caught SAXParseException: " << xmlstring{e.getMessage()} << endl;
+  } catch (const exception& e) {
+    err << file << ": " << e.what() << endl;
+  } catch (...) {
+    err << file << ": caught exception" << endl;
+  }
+  return false;
+}
+
+bool
+pom_batch_rewriter::rewrite_doc(const string& file, const xml_doc_buffer& buffer, const pom_cache::key& cache_key, ostream& os, ostream& err, pom_doc_stats& stats) {
+  pom_phase_timer parse_timer{stats.parse};
+  const xml_parse_counters parse_counters{thread_parse_counters()};
+  const xml_graph::xml_doc<xml_graph::xml_node> doc{doc_parser.parse_doc(buffer.data(), buffer.size(), file.c_str())};
+  stats.node_cnt = doc->get_span();
+  stats.characters_cnt = thread_parse_counters().characters_cnt - parse_counters.characters_cnt;
+  stats.transcoded_bytes = thread_parse_counters().transcoded_bytes - parse_counters.transcoded_bytes;
+  parse_timer.stop();
+
+  pom_phase_timer rewrite_timer{stats.rewrite};
+  const pom_xml_node pom{rewriter.rewrite_pom(doc.get())};
+  rewrite_timer.stop();
+
+  const pom_phase_timer serialize_timer{stats.serialize};
+  writer.clear();
+  if (options.check) {
+    // compared as it's serialized, so a non-canonical file is given up on at its first difference
+    writer.expect(buffer.data(), buffer.size());
+    writer << pom;
+    stats.bytes_out = writer.mismatch_offset();
+    if (writer.matches()) {
+      if (cache)
+        cache->add_canonical(cache_key);
+      return true;
+    }
+    report_not_canonical(file, buffer, writer.mismatch_offset(), err);
+    return false;
+  }
+  writer.reserve(buffer.size() + buffer.size() / 8);
+  writer << pom;
+  const bool canonical{writer.size() == buffer.size() && !memcmp(writer.data(), buffer.data(), buffer.size())};
+  if (!options.in_place)
+    os << writer;
+  else if (!canonical)
+    replace_file(file);
+  stats.bytes_out = writer.size();
+  if (canonical && cache)
+    cache->add_canonical(cache_key);
+  return true;
+}
+
+// output is handed on whenever the writer holds stream_flush_len bytes: with --in-place to a replacement file, but only once it
+// stops matching the file (so that a canonical file isn't replaced), with --check not at all, and otherwise to a spool_file that
+// goes to os once the whole document is done; so a file found out of order or not canonical under --check is left to rewrite_doc
+// (and one that fails is reported) with nothing written
+bool
+pom_batch_rewriter::stream_doc(const string& file, const xml_doc_buffer& buffer, const pom_cache::key& cache_key, ostream& os, pom_doc_stats& stats) {
+  pom_phase_stats stream_phase;
+  pom_phase_timer stream_timer{stream_phase};
+  const xml_parse_counters parse_counters{thread_parse_counters()};
+  unique_ptr<replacement_file> replacement;
+  spool_file spool{nullptr, fclose};
+  size_t out_len{};
+  bool canonical{true};
+  // the last chunk goes straight to os if nothing was spooled before it
+  const auto hand_on = [&](bool last) {
+    if (canonical && (out_len + writer.size() > buffer.size() || memcmp(buffer.data() + out_len, writer.data(), writer.size()))) {
+      canonical = false;
+      if (options.in_place) {
+        // everything before this chunk matched, so the file's own bytes stand in for it
+        replacement.reset(new replacement_file{file});
+        replacement->write(buffer.data(), out_len);
+      }
+    }
+    if (options.in_place) {
+      if (replacement)
+        replacement->write(writer.data(), writer.size());
+    } else if (last && !spool)
+      os << writer;
+    else {
+      if (!spool)
+        spool = open_spool();
+      write_spool(spool.get(), writer.data(), writer.size());
+    }
+    out_len += writer.size();
+    writer.clear();
+  };
+
+  writer.clear();
+  if (options.check)
+    writer.expect(buffer.data(), buffer.size());
+  stream_rewriter->start(buffer.data(), buffer.size(), file.c_str());
+  while (writer && stream_rewriter->next()) {
+    if (!options.check && writer.size() >= stream_flush_len)
+      hand_on(false);
+  }
+  stream_rewriter->stop();
+  stream_timer.stop();
+  // a --check that stopped at a difference hasn't seen whether the sections after it are in order, so where the rewrite first
+  // differs is only known once the whole document has been rewritten
+  if (!stream_rewriter->in_order() || (options.check && !writer.matches())) {
+    stats.parse += stream_phase;
+    return false;
+  }
+  stats.node_cnt = stream_rewriter->node_cnt();
+  stats.characters_cnt = thread_parse_counters().characters_cnt - parse_counters.characters_cnt;
+  stats.transcoded_bytes = thread_parse_counters().transcoded_bytes - parse_counters.transcoded_bytes;
+  stats.rewrite += stream_rewriter->get_rewrite_phase();
+  stats.serialize += stream_rewriter->get_serialize_phase();
+  (stream_phase -= stream_rewriter->get_rewrite_phase()) -= stream_rewriter->get_serialize_phase();
+  stats.parse += stream_phase;
+
+  if (options.check) {
+    stats.bytes_out = writer.mismatch_offset();
+    if (cache)
+      cache->add_canonical(cache_key);
+    return true;
+  }
+  hand_on(true);
+  if (spool)
+    copy_spool(spool.get(), os);
+  canonical = canonical && out_len == buffer.size();
+  if (options.in_place && !canonical) {
+    if (!replacement) {
+      replacement.reset(new replacement_file{file});
+      replacement->write(buffer.data(), out_len);
+    }
+    if (may_replace(file, replacement->temporary_file()))
+      replacement->commit();
+  }
+  stats.bytes_out = out_len;
+  if (canonical && cache)
+    cache->add_canonical(cache_key);
+  return true;
+}
+
+vector<string>
+read_file_list(istream& is, char delim) {
+  vector<string> files;
+  string file;
+  while (getline(is, file, delim)) {
+    if (delim == '\n' && !file.empty() && file.back() == '\r')
+      file.pop_back();
+    if (!file.empty())
+      files.push_back(file);
+  }
+  return files;
+}
+
+namespace {
+struct file_result {
+  std::string out;
+  std::string err;
+  bool ok;
+  bool done;
+
+  file_result() : ok{}, done{} {}
+};
+
+bool
+rewrite_files_in_turn(const vector<string>& files, const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, pom_cache* cache, pom_doc_stats* doc_stats, ostream& os, ostream& err) {
+  bool ok{true};
+  pom_batch_rewriter batch_rewriter{preferred_artifacts, options, cache};
+  for (size_t i{}; i < files.size(); ++i) {
+    if (!batch_rewriter.rewrite_file(files[i], os, err, doc_stats ? doc_stats + i : nullptr))
+      ok = false;
+  }
+  return ok;
+}
+
+bool
+rewrite_files_in_parallel(const vector<string>& files, const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, pom_cache* cache, pom_doc_stats* doc_stats, unsigned int jobs, ostream& os, ostream& err) {
+  bool ok{true};
+  // workers claim the next unclaimed file until none are left, so a slow POM never holds up the others' queues
+  vector<file_result> results(files.size());
+  atomic<size_t> next_file{};
+  mutex results_mutex;
+  condition_variable result_done;
+  vector<thread> workers;
+  for (auto i = 0U; i < jobs; ++i) {
+    workers.emplace_back([&]() {
+      // a worker that can't set up (e.g. Xerces can't create a reader) still claims files, failing each, so that none is waited
+      // for in vain; nothing may escape the thread
+      unique_ptr<pom_batch_rewriter> batch_rewriter;
+      string setup_err;
+      try {
+        batch_rewriter.reset(new pom_batch_rewriter{preferred_artifacts, options, cache});
+      } catch (const XMLException& e) {
+        setup_err = "caught XMLException: " + xmlstring{e.getMessage()};
+      } catch (const exception& e) {
+        setup_err = e.what();
+      } catch (...) {
+        setup_err = "caught exception";
+      }
+      for (size_t j; (j = next_file++) < files.size();) {
+        ostringstream out_oss, err_oss;
+        bool file_ok{};
+        if (batch_rewriter)
+          file_ok = batch_rewriter->rewrite_file(files[j], out_oss, err_oss, doc_stats ? doc_stats + j : nullptr);
+        else
+          err_oss << files[j] << ": " << setup_err << endl;
+        {
+          lock_guard<mutex> lock{results_mutex};
+          results[j].out = out_oss.str();
+          results[j].err = err_oss.str();
+          results[j].ok = file_ok;
+          results[j].done = true;
+        }
+        result_done.notify_one();
+      }
+    });
+  }
+
+  // emit results in file order as soon as each one (and all before it) is done
+  for (auto& result : results) {
+    {
+      unique_lock<mutex> lock{results_mutex};
+      result_done.wait(lock, [&result]() { return result.done; });
+    }
+    os << result.out;
+    err << result.err;
+    if (!result.ok)
+      ok = false;
+    string{}.swap(result.out);
+  }
+  for (auto& worker : workers)
+    worker.join();
+  return ok;
+}
+}
+
+bool
+rewrite_files(const vector<string>& files, const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, ostream& os, ostream& err, pom_stats* stats) {
+  const auto wall_start = chrono::steady_clock::now();
+  unsigned int jobs{options.jobs};
+  if (!jobs)
+    jobs = max(thread::hardware_concurrency(), 1U);
+  jobs = static_cast<unsigned int>(min<size_t>(jobs, files.size()));
+  // each file's stats are only ever touched by the thread rewriting it
+  pom_doc_stats* doc_stats{};
+  if (stats) {
+    stats->docs.assign(files.size(), pom_doc_stats{});
+    doc_stats = stats->docs.data();
+  }
+
+  unique_ptr<pom_cache> cache{options.cache_dir.empty() ? nullptr : new pom_cache{options.cache_dir, preferred_artifacts}};
+  const bool ok{jobs <= 1 ? rewrite_files_in_turn(files, preferred_artifacts, options, cache.get(), doc_stats, os, err) : rewrite_files_in_parallel(files, preferred_artifacts, options, cache.get(), doc_stats, jobs, os, err)};
+  // a cache that can't be saved costs the next run time, not this run its result
+  if (cache) {
+    try {
+      cache->save();
+    } catch (const exception& e) {
+      err << e.what() << endl;
+    }
+  }
+  if (stats) {
+    stats->jobs = max(jobs, 1U);
+    stats->wall_secs = chrono::duration<double>(chrono::steady_clock::now() - wall_start).count();
+  }
+  return ok;
+}
+}
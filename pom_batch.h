@@ -0,0 +1,80 @@
+#ifndef POM_BATCH_H
+#define POM_BATCH_H
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pom_cache.h"
+#include "pom_stats.h"
+#include "pom_stream.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+#include "xml_parser.h"
+#include "xml_writer.h"
+
+namespace pommade {
+
+struct pom_batch_options {
+  unsigned int jobs;
+  // replace each file with its rewrite (through a temporary file renamed over it) instead of writing to the output stream
+  bool in_place;
+  // only compare each file against its rewrite, reporting the first line where they differ
+  bool check;
+  // where the pom_cache file lives; empty for no cache
+  std::string cache_dir;
+  xml_parser::xml_parser_backend parser_backend;
+  // rewrite each file with a pom_stream_rewriter, handing output on as it's made (to the output stream only once the whole document
+  // is done, through a temporary file) and falling back to the whole-document rewrite for a file it can't stream
+  bool stream;
+  // make the modules each POM lists known (see listed_modules()), even for a POM the pom_cache has as canonical, which then has to
+  // be parsed and rewritten after all (but not written)
+  bool list_modules;
+  // read each file into memory rather than mapping it, for files that may be truncated while they're rewritten
+  bool read_files;
+  // with in_place, asked just before a file is replaced by its rewrite, already written to the replacement file that's to be
+  // renamed over it (say, whether the file is still as it was read): one it turns down is left as it is, which isn't a failure
+  std::function<bool(const std::string& file, const std::string& replacement)> may_replace;
+
+  pom_batch_options() : jobs{1}, in_place{}, check{}, parser_backend{xml_parser::xml_parser_backend::native}, stream{}, list_modules{}, read_files{} {}
+};
+
+// rewrites any number of POMs in turn, reusing one parser, document handler, rewriter and output buffer
+class pom_batch_rewriter {
+  const pom_batch_options& options;
+  pom_cache* const cache;
+  xml_parser::default_xml_doc_handler doc_handler;
+  xml_parser::xml_doc_parser doc_parser;
+  pom_rewriter rewriter;
+  xml_graph::xml_writer writer;
+  std::unique_ptr<pom_stream_rewriter> stream_rewriter;
+
+  bool may_replace(const std::string& file, const std::string& replacement) const { return !options.may_replace || options.may_replace(file, replacement); }
+  void replace_file(const std::string& file) const;
+  bool rewrite_doc(const std::string& file, const xml_parser::xml_doc_buffer& buffer, const pom_cache::key& cache_key, std::ostream& os, std::ostream& err, pom_doc_stats& stats);
+  // whether the file could be streamed, or has to be left to rewrite_doc
+  bool stream_doc(const std::string& file, const xml_parser::xml_doc_buffer& buffer, const pom_cache::key& cache_key, std::ostream& os, pom_doc_stats& stats);
+
+ public:
+  pom_batch_rewriter(const std::vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, pom_cache* cache = nullptr) : options{options}, cache{cache}, doc_parser{doc_handler, options.parser_backend}, rewriter{preferred_artifacts}, stream_rewriter{options.stream ? new pom_stream_rewriter{rewriter, writer} : nullptr} {}
+
+  // file may be stdin_file, but not with options.in_place; on failure nothing is written to os (nor to the file), the reason goes
+  // to err and false is returned; what each phase cost goes to doc_stats, if given
+  bool rewrite_file(const std::string& file, std::ostream& os, std::ostream& err, pom_doc_stats* doc_stats = nullptr);
+  // after a successful rewrite_file, the module paths its POM lists (relative to its directory), with options.list_modules
+  const std::vector<std::string>& listed_modules() const { return rewriter.get_modules(); }
+};
+
+// the file name that stands for standard input
+const char stdin_file[] = "-";
+
+std::vector<std::string> read_file_list(std::istream& is, char delim = '\n');
+
+// rewrites files on up to options.jobs threads (0: one per core), each with its own pom_batch_rewriter (and all sharing one
+// pom_cache, saved at the end); output is written to os in file order, and each file's costs to stats (if given) in file order
+bool rewrite_files(const std::vector<std::string>& files, const std::vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, std::ostream& os, std::ostream& err, pom_stats* stats = nullptr);
+}
+#endif
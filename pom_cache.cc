@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "pom_cache.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+
+namespace pommade {
+using namespace std;
+using namespace xml_parser;
+
+const char pom_cache::magic[8] = {'p', 'o', 'm', 'c', 'a', 'c', 'h', 'e'};
+const uint32_t pom_cache::format;
+const uint32_t pom_cache::max_idle_saves;
+const size_t pom_cache::max_entry_cnt;
+
+namespace {
+uint64_t
+make_seed(const vector<pom_artifact_matcher>& preferred_artifacts) {
+  string config{"pommade " + to_string(pom_rewriter::output_version) + '\n'};
+  for (const auto& preferred_artifact : preferred_artifacts)
+    config += preferred_artifact.group_id + ':' + preferred_artifact.artifact_id + '\n';
+  return pom_cache::hash_bytes(config.data(), config.size(), 0);
+}
+}
+
+pom_cache::pom_cache(const string& dir, const vector<pom_artifact_matcher>& preferred_artifacts) : file{(boost::filesystem::path{dir} / "pommade.cache").string()}, seed{make_seed(preferred_artifacts)}, mapped_header{}, mapped_entries{} {
+  try {
+    if (!boost::filesystem::exists(file))
+      return;
+    mapped.reset(new xml_doc_buffer{xml_doc_buffer::map_file(file.c_str())});
+  } catch (const exception&) {
+    return;
+  }
+  // anything but an intact file of this format is ignored (and replaced on save)
+  if (mapped->size() < sizeof(header))
+    return;
+  const header* const h = reinterpret_cast<const header*>(mapped->data());
+  if (memcmp(h->magic, magic, sizeof magic) || h->format != format || h->entry_cnt != (mapped->size() - sizeof(header)) / sizeof(entry) || (mapped->size() - sizeof(header)) % sizeof(entry))
+    return;
+  mapped_header = h;
+  mapped_entries = reinterpret_cast<const entry*>(mapped->data() + sizeof(header));
+}
+
+pom_cache::~pom_cache() {}
+
+// MurmurHash64A
+uint64_t
+pom_cache::hash_bytes(const char* bytes, size_t len, uint64_t seed) {
+  const uint64_t m{0xc6a4a7935bd1e995ULL};
+  const int r{47};
+  uint64_t h{seed ^ (len * m)};
+  const char* const end = bytes + (len & ~size_t{7});
+  for (; bytes != end; bytes += 8) {
+    uint64_t k;
+    memcpy(&k, bytes, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  const unsigned char* const tail = reinterpret_cast<const unsigned char*>(bytes);
+  switch (len & 7) {
+  case 7: h ^= uint64_t{tail[6]} << 48;
+  case 6: h ^= uint64_t{tail[5]} << 40;
+  case 5: h ^= uint64_t{tail[4]} << 32;
+  case 4: h ^= uint64_t{tail[3]} << 24;
+  case 3: h ^= uint64_t{tail[2]} << 16;
+  case 2: h ^= uint64_t{tail[1]} << 8;
+  case 1:
+    h ^= uint64_t{tail[0]};
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+bool
+pom_cache::is_canonical(const key& k) {
+  if (!mapped_header)
+    return false;
+  const entry* const end = mapped_entries + mapped_header->entry_cnt;
+  const entry* const e = lower_bound(mapped_entries, end, k, [](const entry& e, const key& k) { return e.k < k; });
+  if (e == end || !(e->k == k))
+    return false;
+  // hits only need recording (and so the file rewriting) once an entry is getting on towards eviction
+  if (e->last_hit_save + max_idle_saves / 2 < mapped_header->save_cnt) {
+    lock_guard<mutex> lock{updates_mutex};
+    hit_keys.push_back(k);
+  }
+  return true;
+}
+
+void
+pom_cache::add_canonical(const key& k) {
+  lock_guard<mutex> lock{updates_mutex};
+  added_keys.push_back(k);
+}
+
+void
+pom_cache::save() {
+  lock_guard<mutex> lock{updates_mutex};
+  if (hit_keys.empty() && added_keys.empty())
+    return;
+
+  const uint32_t save_cnt{mapped_header ? mapped_header->save_cnt + 1 : 1};
+  vector<entry> entries;
+  if (mapped_header) {
+    for (auto e = mapped_entries; e != mapped_entries + mapped_header->entry_cnt; ++e) {
+      if (e->last_hit_save + max_idle_saves >= save_cnt)
+        entries.push_back(*e);
+    }
+  }
+  sort(hit_keys.begin(), hit_keys.end());
+  for (auto& e : entries) {
+    if (binary_search(hit_keys.cbegin(), hit_keys.cend(), e.k))
+      e.last_hit_save = save_cnt;
+  }
+  for (const auto& k : added_keys)
+    entries.push_back(entry{k, save_cnt, 0});
+  // the most recently hit of any duplicates come first, so they're the ones kept
+  sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.k < b.k || (a.k == b.k && a.last_hit_save > b.last_hit_save); });
+  entries.erase(unique(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.k == b.k; }), entries.end());
+  if (entries.size() > max_entry_cnt) {
+    nth_element(entries.begin(), entries.begin() + max_entry_cnt, entries.end(), [](const entry& a, const entry& b) { return a.last_hit_save > b.last_hit_save; });
+    entries.resize(max_entry_cnt);
+    sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) { return a.k < b.k; });
+  }
+
+  header h{};
+  memcpy(h.magic, magic, sizeof magic);
+  h.format = format;
+  h.save_cnt = save_cnt;
+  h.entry_cnt = entries.size();
+  try {
+    const boost::filesystem::path path{file};
+    boost::filesystem::create_directories(path.parent_path());
+    const boost::filesystem::path tmp_path{boost::filesystem::unique_path(path.string() + ".%%%%%%%%")};
+    {
+      ofstream ofs{tmp_path.string(), ios::binary};
+      ofs.write(reinterpret_cast<const char*>(&h), sizeof h);
+      ofs.write(reinterpret_cast<const char*>(entries.data()), static_cast<streamsize>(entries.size() * sizeof(entry)));
+      ofs.close();
+      if (!ofs) {
+        boost::filesystem::remove(tmp_path);
+        throw runtime_error{"can't write '" + tmp_path.string() + '\''};
+      }
+    }
+    boost::filesystem::rename(tmp_path, path);
+  } catch (const boost::filesystem::filesystem_error& e) {
+    throw runtime_error{string{"can't save cache: "} + e.what()};
+  }
+  hit_keys.clear();
+  added_keys.clear();
+}
+}
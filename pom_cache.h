@@ -0,0 +1,80 @@
+#ifndef POM_CACHE_H
+#define POM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rewrite_pom.h"
+
+namespace xml_parser {
+class xml_doc_buffer;
+}
+
+namespace pommade {
+
+// remembers, across runs, which POMs are already canonical: a POM is known by a hash of its bytes (seeded with the rewriter's
+// output version and the preferred artifacts), and one found in the cache needn't be parsed at all; only canonical POMs are
+// recorded, as a rewrite that differs from its POM still has to be made to be written (or, with --check, located)
+//
+// the cache file is a header and entries sorted by key, looked up in place through a read-only mapping; entries added or hit
+// during a run are merged in by save(), which replaces the file atomically (a concurrent run's additions may be lost, never
+// corrupted) and drops entries that haven't been hit in max_idle_saves saves, then the least recently hit ones beyond
+// max_entry_cnt
+class pom_cache {
+ public:
+  struct key {
+    std::uint64_t hash;
+    std::uint64_t size;
+
+    bool operator==(const key& that) const { return hash == that.hash && size == that.size; }
+    bool operator<(const key& that) const { return hash < that.hash || (hash == that.hash && size < that.size); }
+  };
+
+ private:
+  struct header {
+    char magic[8];
+    std::uint32_t format;
+    std::uint32_t save_cnt;
+    std::uint64_t entry_cnt;
+  };
+  struct entry {
+    key k;
+    std::uint32_t last_hit_save;
+    std::uint32_t unused;
+  };
+
+  static const char magic[8];
+  static const std::uint32_t format = 1;
+  static const std::uint32_t max_idle_saves = 32;
+  static const std::size_t max_entry_cnt = 1 << 20;
+
+  const std::string file;
+  const std::uint64_t seed;
+  std::unique_ptr<xml_parser::xml_doc_buffer> mapped;
+  const header* mapped_header;
+  const entry* mapped_entries;
+  std::mutex updates_mutex;
+  std::vector<key> hit_keys;
+  std::vector<key> added_keys;
+
+ public:
+  // a missing or unreadable cache file just starts the cache empty
+  pom_cache(const std::string& dir, const std::vector<pom_artifact_matcher>& preferred_artifacts);
+  ~pom_cache();
+
+  static std::uint64_t hash_bytes(const char* bytes, std::size_t len, std::uint64_t seed);
+
+  key make_key(const char* bytes, std::size_t len) const { return key{hash_bytes(bytes, len, seed), len}; }
+  // both are safe to call from several threads at once
+  bool is_canonical(const key& k);
+  void add_canonical(const key& k);
+
+  // throws runtime_error if the cache file can't be written
+  void save();
+};
+}
+#endif
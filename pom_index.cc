@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/util/XMLException.hpp>
+
+#include "pom_batch.h"
+#include "pom_index.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+#include "xml_graph.h"
+#include "xml_parser.h"
+
+namespace pommade {
+using namespace std;
+using namespace xercesc_3_1;
+using namespace xml_graph;
+using namespace xml_parser;
+
+namespace {
+// surrounding whitespace aside
+string
+trimmed(const xml_text& text) {
+  const string str{text.str()};
+  const auto first = str.find_first_not_of(" \t\r\n"), last = str.find_last_not_of(" \t\r\n");
+  return first == string::npos ? string{} : str.substr(first, last - first + 1);
+}
+}
+
+bool
+pom_artifact_declaration::operator<(const pom_artifact_declaration& that) const {
+  if (managed != that.managed)
+    return managed;
+  return file_i < that.file_i || (file_i == that.file_i && lineno < that.lineno);
+}
+
+// a flat document is one array in document order, so it's walked front to back without recursing; a node is in a
+// dependencyManagement section while it's before the end of that section's span
+void
+pom_artifact_index::add_doc(size_t file_i, const xml_node& root) {
+  const xml_node* const end{&root + root.get_span()};
+  const xml_node* managed_end{};
+  for (const xml_node* nodep{&root}; nodep != end; ++nodep) {
+    if (nodep == managed_end)
+      managed_end = nullptr;
+    if (nodep->name == xml_names::dependency_management && !managed_end)
+      managed_end = nodep + nodep->get_span();
+    if (nodep->name != xml_names::dependency || !nodep->tree())
+      continue;
+    pom_artifact artifact;
+    pom_artifact_declaration declaration{file_i, nodep->lineno, string{}, string{}, managed_end != nullptr};
+    const auto cend = nodep->tree().cend();
+    for (auto cit = nodep->tree().cbegin(); cit != cend; ++cit) {
+      if (!cit->get_content())
+        continue;
+      if (cit->name == xml_names::group_id)
+        artifact.group_id = trimmed(cit->get_content());
+      else if (cit->name == xml_names::artifact_id)
+        artifact.artifact_id = trimmed(cit->get_content());
+      else if (cit->name == xml_names::version)
+        declaration.version = trimmed(cit->get_content());
+      else if (cit->name == xml_names::scope)
+        declaration.scope = trimmed(cit->get_content());
+    }
+    if (!artifact.group_id.empty() && !artifact.artifact_id.empty())
+      declarations[move(artifact)].push_back(move(declaration));
+  }
+}
+
+void
+pom_artifact_index::merge(pom_artifact_index&& that) {
+  if (declarations.empty()) {
+    declarations.swap(that.declarations);
+    return;
+  }
+  for (auto& artifact_declarations : that.declarations) {
+    auto& to = declarations[artifact_declarations.first];
+    if (to.empty())
+      to.swap(artifact_declarations.second);
+    else
+      to.insert(to.end(), make_move_iterator(artifact_declarations.second.begin()), make_move_iterator(artifact_declarations.second.end()));
+  }
+  that.declarations.clear();
+}
+
+size_t
+pom_artifact_index::write_conflicts(ostream& os) const {
+  // only the (few) conflicting artifacts are sorted
+  map<pom_artifact, vector<const pom_artifact_declaration*>> conflicts;
+  for (const auto& artifact_declarations : declarations) {
+    set<string> versions;
+    for (const auto& declaration : artifact_declarations.second) {
+      if (!declaration.version.empty())
+        versions.insert(declaration.version);
+    }
+    if (versions.size() < 2)
+      continue;
+    auto& versioned = conflicts[artifact_declarations.first];
+    for (const auto& declaration : artifact_declarations.second) {
+      if (!declaration.version.empty())
+        versioned.push_back(&declaration);
+    }
+    sort(versioned.begin(), versioned.end(), [](const pom_artifact_declaration* a, const pom_artifact_declaration* b) { return *a < *b; });
+  }
+  for (const auto& conflict : conflicts) {
+    os << conflict.first.group_id << ':' << conflict.first.artifact_id << '\n';
+    for (const auto declarationp : conflict.second) {
+      os << '\t' << declarationp->version << '\t' << files[declarationp->file_i] << ':' << declarationp->lineno;
+      if (declarationp->managed)
+        os << "\tmanaged";
+      if (!declarationp->scope.empty())
+        os << '\t' << declarationp->scope;
+      os << '\n';
+    }
+  }
+  os.flush();
+  return conflicts.size();
+}
+
+bool
+report_version_conflicts(const vector<string>& files, const pom_batch_options& options, ostream& os, ostream& err) {
+  unsigned int jobs{options.jobs};
+  if (!jobs)
+    jobs = max(thread::hardware_concurrency(), 1U);
+  jobs = static_cast<unsigned int>(max<size_t>(min<size_t>(jobs, files.size()), 1));
+
+  // each worker indexes into its own index, merged once all are done; errors are kept by file, to be reported in file order, and
+  // only a file that couldn't be indexed fails the run (not one that was merely warned about)
+  vector<unique_ptr<pom_artifact_index>> worker_indexes;
+  for (auto i = 0U; i < jobs; ++i)
+    worker_indexes.emplace_back(new pom_artifact_index{files});
+  vector<string> file_errs(files.size());
+  vector<char> file_oks(files.size(), true);
+  atomic<size_t> next_file{};
+  auto work = [&](pom_artifact_index& index) {
+    // a worker that can't set up still claims files, failing each; nothing may escape the thread
+    default_xml_doc_handler doc_handler;
+    unique_ptr<xml_doc_parser> doc_parser;
+    string setup_err;
+    try {
+      doc_parser.reset(new xml_doc_parser{doc_handler, options.parser_backend});
+    } catch (const XMLException& e) {
+      setup_err = "caught XMLException: " + xmlstring{e.getMessage()};
+    } catch (const exception& e) {
+      setup_err = e.what();
+    } catch (...) {
+      setup_err = "caught exception";
+    }
+    for (size_t i; (i = next_file++) < files.size();) {
+      const string& file = files[i];
+      ostringstream err_oss;
+      // Xerces' warnings and the like are kept with the file's other errors
+      const xml_diagnostics_redirect diagnostics_redirect{err_oss};
+      try {
+        if (!doc_parser)
+          throw runtime_error{setup_err};
+        const xml_doc_buffer buffer{file == stdin_file ? xml_doc_buffer::read(cin) : xml_doc_buffer::map_file(file.c_str())};
+        const xml_doc<xml_node> doc{doc_parser->parse_doc(buffer.data(), buffer.size(), file.c_str())};
+        if (!doc || doc->name != xml_names::project)
+          throw runtime_error{"root project node missing or empty"};
+        index.add_doc(i, *doc);
+      } catch (const XMLException& e) {
+        err_oss << file << ": caught XMLException: " << xmlstring{e.getMessage()} << endl;
+        file_oks[i] = false;
+      } catch (const SAXParseException& e) {
+        err_oss << file << ": caught SAXParseException: " << xmlstring{e.getMessage()} << endl;
+        file_oks[i] = false;
+      } catch (const exception& e) {
+        err_oss << file << ": " << e.what() << endl;
+        file_oks[i] = false;
+      } catch (...) {
+        err_oss << file << ": caught exception" << endl;
+        file_oks[i] = false;
+      }
+      file_errs[i] = err_oss.str();
+    }
+  };
+  vector<thread> workers;
+  for (auto i = 1U; i < jobs; ++i)
+    workers.emplace_back(work, ref(*worker_indexes[i]));
+  work(*worker_indexes[0]);
+  for (auto& worker : workers)
+    worker.join();
+
+  bool ok{true};
+  for (size_t i{}; i < files.size(); ++i) {
+    err << file_errs[i];
+    ok = ok && file_oks[i];
+  }
+  pom_artifact_index& index = *worker_indexes[0];
+  for (auto i = 1U; i < jobs; ++i)
+    index.merge(move(*worker_indexes[i]));
+  return index.write_conflicts(os) == 0 && ok;
+}
+}
@@ -0,0 +1,58 @@
+#ifndef POM_INDEX_H
+#define POM_INDEX_H
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pom_batch.h"
+#include "rewrite_pom.h"
+#include "xml_graph.h"
+
+namespace pommade {
+
+struct pom_artifact_hash {
+  std::size_t operator()(const pom_artifact& artifact) const { return std::hash<std::string>{}(artifact.group_id) * 31 + std::hash<std::string>{}(artifact.artifact_id); }
+};
+
+// one <dependency> on an artifact, wherever in a POM it is
+struct pom_artifact_declaration {
+  // an index into the indexed files
+  std::size_t file_i;
+  unsigned long lineno;
+  // empty if not given (i.e. left to dependencyManagement)
+  std::string version;
+  std::string scope;
+  // in a dependencyManagement section, rather than a dependency of the project, a profile or a plugin
+  bool managed;
+
+  bool operator<(const pom_artifact_declaration& that) const;
+};
+
+// every dependency declared by a set of POMs, by groupId and artifactId
+class pom_artifact_index {
+  // the files declarations' file_i index, which must outlive the index
+  const std::vector<std::string>& files;
+  std::unordered_map<pom_artifact, std::vector<pom_artifact_declaration>, pom_artifact_hash> declarations;
+
+ public:
+  explicit pom_artifact_index(const std::vector<std::string>& files) : files{files} {}
+
+  // adds the dependencies in a file's document (a project, or any part of one)
+  void add_doc(std::size_t file_i, const xml_graph::xml_node& root);
+  // moves that's declarations (of the same files) into this index
+  void merge(pom_artifact_index&& that);
+
+  // writes each artifact declared with more than one version (ordered by groupId and artifactId) and the declarations giving
+  // one, managed ones first; returns the number of such artifacts
+  std::size_t write_conflicts(std::ostream& os) const;
+};
+
+// parses files on up to options.jobs threads (0: one per core), indexing the dependencies they declare, and writes the version
+// conflicts between them to os; false if a file can't be parsed or there's a conflict, as a --check would fail
+bool report_version_conflicts(const std::vector<std::string>& files, const pom_batch_options& options, std::ostream& os, std::ostream& err);
+}
+#endif
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <xercesc/util/XMLException.hpp>
+
+#include "pom_batch.h"
+#include "pom_cache.h"
+#include "pom_reactor.h"
+#include "pom_stats.h"
+#include "rewrite_pom.h"
+#include "xml_parser.h"
+
+namespace pommade {
+using namespace std;
+using namespace xercesc_3_1;
+using namespace xml_parser;
+
+namespace {
+const char* const pom_file_name = "pom.xml";
+
+// one POM of the module tree, filled in once it's been rewritten
+struct reactor_pom {
+  string file;
+  // the POMs first found through this one's modules, in the order listed
+  vector<size_t> modules;
+  string out;
+  string err;
+  bool ok;
+  pom_doc_stats doc_stats;
+
+  explicit reactor_pom(const string& file) : file{file}, ok{} {}
+};
+
+// what a module path (or a root) names: a directory's pom.xml, or a POM file itself
+boost::filesystem::path
+pom_file(const boost::filesystem::path& pom_path) {
+  return boost::filesystem::is_directory(pom_path) ? pom_path / pom_file_name : pom_path;
+}
+
+// the POMs found so far, and those of them still to be rewritten; workers take the next pending POM, and add the modules it lists
+// that haven't been seen (by canonical path) as pending in turn, until none is pending and no worker is busy
+class module_tree {
+  const vector<pom_artifact_matcher>& preferred_artifacts;
+  const pom_batch_options& options;
+  pom_cache* const cache;
+
+  mutex poms_mutex;
+  condition_variable poms_changed;
+  // a deque, so that a POM being filled in stays put while others are added
+  deque<reactor_pom> poms;
+  deque<size_t> pending_poms;
+  unordered_set<string> seen_files;
+  unsigned int busy_cnt;
+
+  bool add_pom(const string& file, const string& canonical_file, size_t& i);
+
+ public:
+  module_tree(const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, pom_cache* cache) : preferred_artifacts{preferred_artifacts}, options{options}, cache{cache}, busy_cnt{} {}
+
+  // before any work(); returns the POM's index, or reports why there's no POM there
+  bool add_root(const string& root, vector<size_t>& roots, ostream& err);
+  void work();
+  void write(size_t i, ostream& os, ostream& err, vector<pom_doc_stats>* docs, bool& ok) const;
+};
+
+// requires poms_mutex to be held
+bool
+module_tree::add_pom(const string& file, const string& canonical_file, size_t& i) {
+  if (!seen_files.insert(canonical_file).second)
+    return false;
+  i = poms.size();
+  poms.emplace_back(file);
+  pending_poms.push_back(i);
+  return true;
+}
+
+bool
+module_tree::add_root(const string& root, vector<size_t>& roots, ostream& err) {
+  const boost::filesystem::path file{pom_file(root)};
+  boost::system::error_code ec;
+  const boost::filesystem::path canonical_file{boost::filesystem::canonical(file, ec)};
+  if (ec) {
+    err << root << ": no POM at '" << file.string() << '\'' << endl;
+    return false;
+  }
+  size_t i;
+  if (add_pom(file.string(), canonical_file.string(), i))
+    roots.push_back(i);
+  return true;
+}
+
+void
+module_tree::work() {
+  // a worker that can't set up still takes POMs, failing each, so that none is waited for in vain; nothing may escape the thread
+  unique_ptr<pom_batch_rewriter> batch_rewriter;
+  string setup_err;
+  try {
+    batch_rewriter.reset(new pom_batch_rewriter{preferred_artifacts, options, cache});
+  } catch (const XMLException& e) {
+    setup_err = "caught XMLException: " + xmlstring{e.getMessage()};
+  } catch (const exception& e) {
+    setup_err = e.what();
+  } catch (...) {
+    setup_err = "caught exception";
+  }
+  unique_lock<mutex> lock{poms_mutex};
+  for (;;) {
+    poms_changed.wait(lock, [this]() { return !pending_poms.empty() || !busy_cnt; });
+    if (pending_poms.empty())
+      return;
+    const size_t i{pending_poms.front()};
+    pending_poms.pop_front();
+    ++busy_cnt;
+    const string file{poms[i].file};
+    lock.unlock();
+
+    // the module paths are resolved (which takes the file system) before the lock is taken again
+    ostringstream out_oss, err_oss;
+    pom_doc_stats doc_stats;
+    bool ok{};
+    if (batch_rewriter)
+      ok = batch_rewriter->rewrite_file(file, out_oss, err_oss, &doc_stats);
+    else
+      err_oss << file << ": " << setup_err << endl;
+    vector<pair<string, string>> module_files;
+    if (ok) {
+      const boost::filesystem::path dir{boost::filesystem::path{file}.parent_path()};
+      for (const auto& module : batch_rewriter->listed_modules()) {
+        const boost::filesystem::path module_file{pom_file(dir / module)};
+        boost::system::error_code ec;
+        const boost::filesystem::path canonical_module_file{boost::filesystem::canonical(module_file, ec)};
+        if (ec) {
+          err_oss << file << ": module '" << module << "': no POM at '" << module_file.string() << '\'' << endl;
+          ok = false;
+        } else
+          module_files.emplace_back(module_file.string(), canonical_module_file.string());
+      }
+    }
+
+    lock.lock();
+    reactor_pom& pom = poms[i];
+    pom.out = out_oss.str();
+    pom.err = err_oss.str();
+    pom.ok = ok;
+    pom.doc_stats = move(doc_stats);
+    for (const auto& module_file : module_files) {
+      size_t module_i;
+      if (add_pom(module_file.first, module_file.second, module_i))
+        pom.modules.push_back(module_i);
+    }
+    --busy_cnt;
+    poms_changed.notify_all();
+  }
+}
+
+// each POM before its modules
+void
+module_tree::write(size_t i, ostream& os, ostream& err, vector<pom_doc_stats>* docs, bool& ok) const {
+  const reactor_pom& pom = poms[i];
+  os << pom.out;
+  err << pom.err;
+  if (!pom.ok)
+    ok = false;
+  if (docs)
+    docs->push_back(pom.doc_stats);
+  for (const size_t module_i : pom.modules)
+    write(module_i, os, err, docs, ok);
+}
+}
+
+bool
+rewrite_reactor(const vector<string>& roots, const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, ostream& os, ostream& err, pom_stats* stats) {
+  const auto wall_start = chrono::steady_clock::now();
+  unsigned int jobs{options.jobs};
+  if (!jobs)
+    jobs = max(thread::hardware_concurrency(), 1U);
+  pom_batch_options reactor_options{options};
+  reactor_options.list_modules = true;
+
+  bool ok{true};
+  unique_ptr<pom_cache> cache{options.cache_dir.empty() ? nullptr : new pom_cache{options.cache_dir, preferred_artifacts}};
+  module_tree tree{preferred_artifacts, reactor_options, cache.get()};
+  vector<size_t> root_is;
+  for (const auto& root : roots) {
+    if (!tree.add_root(root, root_is, err))
+      ok = false;
+  }
+  vector<thread> workers;
+  for (auto i = 0U; i < jobs; ++i)
+    workers.emplace_back([&tree]() { tree.work(); });
+  for (auto& worker : workers)
+    worker.join();
+
+  if (stats)
+    stats->docs.clear();
+  for (const size_t root_i : root_is)
+    tree.write(root_i, os, err, stats ? &stats->docs : nullptr, ok);
+  // a cache that can't be saved costs the next run time, not this run its result
+  if (cache) {
+    try {
+      cache->save();
+    } catch (const exception& e) {
+      err << e.what() << endl;
+    }
+  }
+  if (stats) {
+    stats->jobs = jobs;
+    stats->wall_secs = chrono::duration<double>(chrono::steady_clock::now() - wall_start).count();
+  }
+  return ok;
+}
+}
@@ -0,0 +1,20 @@
+#ifndef POM_REACTOR_H
+#define POM_REACTOR_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pom_batch.h"
+#include "pom_stats.h"
+#include "rewrite_pom.h"
+
+namespace pommade {
+
+// rewrites each root POM (or the pom.xml in a root directory) and, following every <module> it lists to that module's POM, the
+// whole multi-module build below it: POMs are rewritten on up to options.jobs threads (0: one per core) as soon as they're found,
+// and each only once, however many paths (or symlinks) lead to it; output is written to os (and costs to stats, if given) in module
+// tree order, i.e. each POM before its modules, in the order listed
+bool rewrite_reactor(const std::vector<std::string>& roots, const std::vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, std::ostream& os, std::ostream& err, pom_stats* stats = nullptr);
+}
+#endif
@@ -0,0 +1,255 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <string>
+
+#include "pom_stats.h"
+
+#if defined(POMMADE_COUNT_ALLOCS)
+namespace {
+thread_local std::size_t alloc_cnt;
+thread_local std::size_t alloc_bytes;
+}
+
+// every other form of operator new and delete is replaced too, forwarding to these two, rather than left to a standard library
+// that may not forward
+void*
+operator new(std::size_t size) {
+  ++alloc_cnt;
+  alloc_bytes += size;
+  if (void* const p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc{};
+}
+
+void
+operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void*
+operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return ::operator new(size);
+  } catch (const std::bad_alloc&) {
+    return nullptr;
+  }
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return ::operator new(size, std::nothrow);
+}
+
+void
+operator delete[](void* p) noexcept {
+  ::operator delete(p);
+}
+
+void
+operator delete(void* p, const std::nothrow_t&) noexcept {
+  ::operator delete(p);
+}
+
+void
+operator delete[](void* p, const std::nothrow_t&) noexcept {
+  ::operator delete(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void
+operator delete(void* p, std::size_t) noexcept {
+  ::operator delete(p);
+}
+
+void
+operator delete[](void* p, std::size_t) noexcept {
+  ::operator delete(p);
+}
+#endif
+#endif
+
+namespace pommade {
+using namespace std;
+
+#if defined(POMMADE_COUNT_ALLOCS)
+const bool pom_stats::counts_allocs = true;
+#else
+const bool pom_stats::counts_allocs = false;
+#endif
+
+namespace {
+// CPU time of the calling thread, so that parallel workers don't count each other's
+double
+thread_cpu_secs() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+  timespec ts;
+  if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+#endif
+  return static_cast<double>(clock()) / CLOCKS_PER_SEC;
+}
+
+void
+thread_alloc_counts(size_t& cnt, size_t& bytes) {
+#if defined(POMMADE_COUNT_ALLOCS)
+  cnt = alloc_cnt;
+  bytes = alloc_bytes;
+#else
+  cnt = bytes = 0;
+#endif
+}
+
+string
+json_string(const string& s) {
+  string json{'"'};
+  for (const char c : s) {
+    if (c == '"' || c == '\\')
+      (json += '\\') += c;
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof escape, "\\u%04x", static_cast<unsigned int>(c));
+      json += escape;
+    } else
+      json += c;
+  }
+  return json += '"';
+}
+
+void
+write_phase_row(ostream& os, const char* name, const pom_phase_stats& phase) {
+  os << left << setw(10) << name << right << fixed << setprecision(1) << setw(12) << phase.wall_secs * 1e3 << setw(12) << phase.cpu_secs * 1e3;
+  if (pom_stats::counts_allocs)
+    os << setw(12) << phase.alloc_cnt << setw(14) << phase.alloc_bytes / 1024.0;
+  else
+    os << setw(12) << '-' << setw(14) << '-';
+  os << endl;
+}
+
+void
+write_phase_json(ostream& os, const char* name, const pom_phase_stats& phase) {
+  os << '"' << name << "\":{\"wall_secs\":" << phase.wall_secs << ",\"cpu_secs\":" << phase.cpu_secs;
+  if (pom_stats::counts_allocs)
+    os << ",\"alloc_cnt\":" << phase.alloc_cnt << ",\"alloc_bytes\":" << phase.alloc_bytes;
+  else
+    os << ",\"alloc_cnt\":null,\"alloc_bytes\":null";
+  os << '}';
+}
+
+void
+write_doc_json(ostream& os, const pom_doc_stats& doc) {
+  os << "{\"bytes_in\":" << doc.bytes_in << ",\"bytes_out\":" << doc.bytes_out << ",\"node_cnt\":" << doc.node_cnt << ",\"characters_cnt\":" << doc.characters_cnt << ",\"transcoded_bytes\":" << doc.transcoded_bytes << ",\"phases\":{";
+  write_phase_json(os, "parse", doc.parse);
+  os << ',';
+  write_phase_json(os, "rewrite", doc.rewrite);
+  os << ',';
+  write_phase_json(os, "serialize", doc.serialize);
+  os << "}}";
+}
+}
+
+pom_phase_stats&
+pom_phase_stats::operator+=(const pom_phase_stats& that) {
+  wall_secs += that.wall_secs;
+  cpu_secs += that.cpu_secs;
+  alloc_cnt += that.alloc_cnt;
+  alloc_bytes += that.alloc_bytes;
+  return *this;
+}
+
+pom_phase_stats&
+pom_phase_stats::operator-=(const pom_phase_stats& that) {
+  wall_secs -= that.wall_secs;
+  cpu_secs -= that.cpu_secs;
+  alloc_cnt -= that.alloc_cnt;
+  alloc_bytes -= that.alloc_bytes;
+  return *this;
+}
+
+pom_phase_timer::pom_phase_timer(pom_phase_stats& phase) : phase{&phase}, wall_start{chrono::steady_clock::now()}, cpu_start{thread_cpu_secs()} {
+  thread_alloc_counts(alloc_cnt_start, alloc_bytes_start);
+}
+
+void
+pom_phase_timer::stop() {
+  if (!phase)
+    return;
+  size_t cnt, bytes;
+  thread_alloc_counts(cnt, bytes);
+  phase->wall_secs += chrono::duration<double>(chrono::steady_clock::now() - wall_start).count();
+  phase->cpu_secs += thread_cpu_secs() - cpu_start;
+  phase->alloc_cnt += cnt - alloc_cnt_start;
+  phase->alloc_bytes += bytes - alloc_bytes_start;
+  phase = nullptr;
+}
+
+pom_doc_stats
+pom_stats::total() const {
+  pom_doc_stats total;
+  for (const auto& doc : docs) {
+    total.bytes_in += doc.bytes_in;
+    total.bytes_out += doc.bytes_out;
+    total.node_cnt += doc.node_cnt;
+    total.characters_cnt += doc.characters_cnt;
+    total.transcoded_bytes += doc.transcoded_bytes;
+    total.parse += doc.parse;
+    total.rewrite += doc.rewrite;
+    total.serialize += doc.serialize;
+  }
+  return total;
+}
+
+// phases are summed over all documents (so with several jobs they may add up to more than the run's wall time), then each
+// document follows in file order
+void
+pom_stats::write_table(ostream& os) const {
+  size_t cached_cnt{};
+  for (const auto& doc : docs)
+    cached_cnt += doc.cached;
+  const pom_doc_stats sum{total()};
+  os << docs.size() << " files (" << cached_cnt << " cached) on " << jobs << (jobs == 1 ? " thread" : " threads") << " in " << fixed << setprecision(1) << wall_secs * 1e3 << " ms" << endl;
+  os << left << setw(10) << "phase" << right << setw(12) << "wall ms" << setw(12) << "cpu ms" << setw(12) << "allocs" << setw(14) << "alloc KB" << endl;
+  write_phase_row(os, "parse", sum.parse);
+  write_phase_row(os, "rewrite", sum.rewrite);
+  write_phase_row(os, "serialize", sum.serialize);
+  pom_phase_stats all{sum.parse};
+  (all += sum.rewrite) += sum.serialize;
+  write_phase_row(os, "total", all);
+
+  os << endl << setw(12) << "bytes in" << setw(12) << "bytes out" << setw(10) << "nodes" << setw(14) << "characters()" << setw(12) << "transcoded" << setw(10) << "parse ms" << setw(12) << "rewrite ms" << setw(14) << "serialize ms" << "  file" << endl;
+  for (const auto& doc : docs) {
+    os << setw(12) << doc.bytes_in << setw(12) << doc.bytes_out;
+    if (doc.cached)
+      os << setw(10) << '-' << setw(14) << '-' << setw(12) << '-' << setw(10) << '-' << setw(12) << '-' << setw(14) << '-' << "  " << doc.file << " (cached)" << endl;
+    else
+      os << setw(10) << doc.node_cnt << setw(14) << doc.characters_cnt << setw(12) << doc.transcoded_bytes << setprecision(2) << setw(10) << doc.parse.wall_secs * 1e3 << setw(12) << doc.rewrite.wall_secs * 1e3 << setw(14) << doc.serialize.wall_secs * 1e3 << "  " << doc.file << endl;
+  }
+  os << setw(12) << sum.bytes_in << setw(12) << sum.bytes_out << setw(10) << sum.node_cnt << setw(14) << sum.characters_cnt << setw(12) << sum.transcoded_bytes << setprecision(2) << setw(10) << sum.parse.wall_secs * 1e3 << setw(12) << sum.rewrite.wall_secs * 1e3 << setw(14) << sum.serialize.wall_secs * 1e3 << "  (total)" << endl;
+}
+
+void
+pom_stats::write_json(ostream& os) const {
+  size_t cached_cnt{};
+  for (const auto& doc : docs)
+    cached_cnt += doc.cached;
+  os << fixed << setprecision(6) << "{\"file_cnt\":" << docs.size() << ",\"cached_cnt\":" << cached_cnt << ",\"jobs\":" << jobs << ",\"wall_secs\":" << wall_secs << ",\"counts_allocs\":" << (counts_allocs ? "true" : "false") << ",\"total\":";
+  write_doc_json(os, total());
+  os << ",\"docs\":[";
+  for (size_t i{}; i < docs.size(); ++i) {
+    os << (i ? ",{" : "{") << "\"file\":" << json_string(docs[i].file) << ",\"cached\":" << (docs[i].cached ? "true" : "false") << ",\"stats\":";
+    write_doc_json(os, docs[i]);
+    os << '}';
+  }
+  os << "]}" << endl;
+}
+}
@@ -0,0 +1,76 @@
+#ifndef POM_STATS_H
+#define POM_STATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace pommade {
+
+// what one phase cost the calling thread; heap allocations are only counted when built with POMMADE_COUNT_ALLOCS (cmake
+// -DBUILD_COUNT_ALLOCS=ON), which replaces the global operator new for the whole process
+struct pom_phase_stats {
+  double wall_secs;
+  double cpu_secs;
+  std::size_t alloc_cnt;
+  std::size_t alloc_bytes;
+
+  pom_phase_stats() : wall_secs{}, cpu_secs{}, alloc_cnt{}, alloc_bytes{} {}
+
+  pom_phase_stats& operator+=(const pom_phase_stats& that);
+  pom_phase_stats& operator-=(const pom_phase_stats& that);
+};
+
+// adds the time (and allocations) from its construction until stop() or its destruction, whichever comes first, to a phase
+class pom_phase_timer {
+  pom_phase_stats* phase;
+  std::chrono::steady_clock::time_point wall_start;
+  double cpu_start;
+  std::size_t alloc_cnt_start;
+  std::size_t alloc_bytes_start;
+
+ public:
+  explicit pom_phase_timer(pom_phase_stats& phase);
+  ~pom_phase_timer() { stop(); }
+  pom_phase_timer(const pom_phase_timer&) = delete;
+  pom_phase_timer& operator=(const pom_phase_timer&) = delete;
+
+  void stop();
+};
+
+struct pom_doc_stats {
+  std::string file;
+  // found canonical in the pom_cache, so neither parsed nor rewritten
+  bool cached;
+  std::size_t bytes_in;
+  // written out (or, with --check, found to match before the first difference)
+  std::size_t bytes_out;
+  std::size_t node_cnt;
+  std::size_t characters_cnt;
+  std::size_t transcoded_bytes;
+  pom_phase_stats parse;
+  pom_phase_stats rewrite;
+  pom_phase_stats serialize;
+
+  pom_doc_stats() : cached{}, bytes_in{}, bytes_out{}, node_cnt{}, characters_cnt{}, transcoded_bytes{} {}
+};
+
+// a batch run's --stats report: the documents in file order, plus the run's own wall time
+struct pom_stats {
+  static const bool counts_allocs;
+
+  unsigned int jobs;
+  double wall_secs;
+  std::vector<pom_doc_stats> docs;
+
+  pom_stats() : jobs{}, wall_secs{} {}
+
+  pom_doc_stats total() const;
+
+  void write_table(std::ostream& os) const;
+  void write_json(std::ostream& os) const;
+};
+}
+#endif
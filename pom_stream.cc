@@ -0,0 +1,250 @@
+#include <cassert>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "pom_stream.h"
+#include "pom_stats.h"
+#include "rewrite_pom.h"
+#include "xml_graph.h"
+#include "xml_parser.h"
+
+namespace pommade {
+using namespace std;
+using namespace xml_graph;
+using namespace xml_parser;
+
+pom_stream_rewriter::pom_stream_rewriter(pom_rewriter& rewriter, xml_writer& writer) : rewriter{rewriter}, writer{writer}, parser{*this}, section_depth{}, section_slot{-1}, skip_depth{}, depth{}, has_comment{}, sections_in_order{true}, nodes{} {}
+
+bool
+pom_stream_rewriter::next() {
+  if (parser.next() && sections_in_order)
+    return true;
+  parser.stop();
+  return false;
+}
+
+xml_text
+pom_stream_rewriter::take_comment() {
+  if (!has_comment)
+    return xml_text{};
+  has_comment = false;
+  return section_builder.get_arena().copy(comment_buf);
+}
+
+void
+pom_stream_rewriter::stream_section(section_kind kind, xml_name name, bool gap_before) {
+  streamed_sections.emplace_back(kind, name, depth - 1, gap_before);
+  if (has_comment) {
+    streamed_sections.back().comment.swap(comment_buf);
+    streamed_sections.back().has_comment = true;
+    has_comment = false;
+  }
+}
+
+void
+pom_stream_rewriter::build_section(unsigned long lineno, xml_name name, int slot) {
+  section_builder.reset(depth - 1);
+  section_builder.start_node(static_cast<unsigned int>(lineno), name, take_comment());
+  section_depth = depth;
+  section_slot = slot;
+}
+
+// rewrites the section just built as the whole-document rewrite would have in the section it's in, and writes it out
+void
+pom_stream_rewriter::end_built_section() {
+  const xml_doc<xml_node> doc{section_builder.doc()};
+  streamed_section& owner = streamed_sections.back();
+  pom_phase_timer rewrite_timer{rewrite_phase};
+  // the rewritten section goes into a stand-in for the one it's in, which is never written itself
+  pom_xml_node rw_owner{doc->get_arena(), 0, owner.level, owner.name, xml_text{}, xml_text{}, false};
+  switch (owner.kind) {
+  case section_kind::project:
+    rewriter.add_project_section(rw_owner, static_cast<size_t>(section_slot), doc.get());
+    break;
+  case section_kind::build:
+    rewriter.add_build_section(rw_owner, static_cast<size_t>(section_slot), doc.get());
+    break;
+  case section_kind::plugins:
+    rw_owner.add_subnode(rewriter.rewrite_plugin_node(*doc, owner.written));
+    break;
+  case section_kind::profiles:
+    rw_owner.add_subnode(rewriter.rewrite_profile_node(*doc, owner.written));
+    break;
+  case section_kind::modules:
+    rw_owner.add_subnode(rewriter.rewrite_module_node(*doc, false));
+    break;
+  }
+  rewrite_timer.stop();
+  if (rw_owner.tree()) {
+    const pom_phase_timer serialize_timer{serialize_phase};
+    write_streamed_sections();
+    writer << *rw_owner.tree();
+  }
+}
+
+void
+pom_stream_rewriter::end_streamed_section() {
+  const pom_phase_timer serialize_timer{serialize_phase};
+  const streamed_section& section = streamed_sections.back();
+  if (section.kind == section_kind::project) {
+    if (!section.has_subnodes)
+      throw runtime_error{"root project node missing or empty"};
+    // unlike the sections in it, a project is written even if all of them were dropped
+    write_streamed_sections();
+  }
+  if (section.written) {
+    writer.indent(section.level);
+    writer << "</" << section.name << '>';
+    writer.newline();
+  }
+  streamed_sections.pop_back();
+}
+
+// writes the opening tags (and what comes before them) of the sections being passed through that haven't been yet, outermost
+// first, as basic_xml_node writes them
+void
+pom_stream_rewriter::write_streamed_sections() {
+  for (auto& section : streamed_sections) {
+    if (section.written)
+      continue;
+    if (section.gap_before)
+      writer.newline();
+    if (section.has_comment) {
+      writer.indent(section.level);
+      writer << "<!--" << xml_text{section.comment.data(), section.comment.size()} << "-->";
+      writer.newline();
+    }
+    writer.indent(section.level);
+    writer << '<' << section.name << '>';
+    writer.newline();
+    section.written = true;
+  }
+}
+
+void
+pom_stream_rewriter::handle_utf8_start_document() {
+  streamed_sections.clear();
+  section_depth = skip_depth = depth = 0;
+  section_slot = -1;
+  node_path.clear();
+  has_comment = false;
+  sections_in_order = true;
+  nodes = 0;
+  rewrite_phase = serialize_phase = pom_phase_stats{};
+}
+
+void
+pom_stream_rewriter::handle_utf8_end_document(unsigned long lineno) {
+  assert(!sections_in_order || streamed_sections.empty());
+  if (has_comment) {
+    thread_diagnostics() << "discarding comment before document end; line " << lineno << endl;
+    has_comment = false;
+  }
+}
+
+void
+pom_stream_rewriter::handle_utf8_start_element(unsigned long lineno, const char* name, size_t len) {
+  ++depth;
+  node_path += '/';
+  node_path.append(name, len);
+  ++nodes;
+  if (skip_depth || !sections_in_order)
+    return;
+  const xml_name node_name{name, len};
+  if (section_depth) {
+    section_builder.start_node(static_cast<unsigned int>(lineno), node_name, take_comment());
+    return;
+  }
+  if (streamed_sections.empty()) {
+    if (node_name != xml_names::project)
+      throw runtime_error{"root project node missing or empty"};
+    rewriter.start_project();
+    stream_section(section_kind::project, node_name, false);
+    return;
+  }
+
+  streamed_section& owner = streamed_sections.back();
+  owner.has_subnodes = true;
+  if (owner.kind != section_kind::project && owner.kind != section_kind::build) {
+    build_section(lineno, node_name, -1);
+    return;
+  }
+  const int slot{owner.kind == section_kind::project ? pom_rewriter::project_classifier::slot(node_name) : pom_rewriter::build_classifier::slot(node_name)};
+  if (slot >= 0 && owner.seen_slots & 1UL << slot)
+    pom_rewriter::fail_duplicate_section(node_name, owner.name, static_cast<unsigned int>(lineno));
+  if (slot < 0) {
+    // dropped by the rewrite, along with its comment
+    skip_depth = depth;
+    has_comment = false;
+    return;
+  }
+  if (slot < owner.last_slot) {
+    sections_in_order = false;
+    return;
+  }
+  owner.seen_slots |= 1UL << slot;
+  owner.last_slot = slot;
+  if (owner.kind == section_kind::project && slot == pom_rewriter::project_build)
+    stream_section(section_kind::build, node_name, true);
+  else if (owner.kind == section_kind::project && slot == pom_rewriter::project_modules)
+    stream_section(section_kind::modules, node_name, true);
+  else if (owner.kind == section_kind::project && slot == pom_rewriter::project_profiles)
+    stream_section(section_kind::profiles, node_name, true);
+  else if (owner.kind == section_kind::build && slot == pom_rewriter::build_plugins)
+    // set apart from the plugin management before it, if that was written
+    stream_section(section_kind::plugins, node_name, owner.written);
+  else
+    build_section(lineno, node_name, slot);
+}
+
+void
+pom_stream_rewriter::handle_utf8_end_element(unsigned long lineno, const char* name, size_t len) {
+  assert(node_path.compare(node_path.rfind('/') + 1, string::npos, name, len) == 0);
+  if (has_comment) {
+    thread_diagnostics() << "discarding comment before '" + node_path + "' end; line " << lineno << endl;
+    has_comment = false;
+  }
+  if (skip_depth) {
+    if (depth == skip_depth)
+      skip_depth = 0;
+  } else if (section_depth && sections_in_order) {
+    section_builder.end_node();
+    if (depth == section_depth) {
+      section_depth = 0;
+      end_built_section();
+    }
+  } else if (sections_in_order)
+    end_streamed_section();
+  node_path.resize(node_path.rfind('/'));
+  --depth;
+}
+
+void
+pom_stream_rewriter::handle_utf8_element_source(const char* chars, size_t len) {
+  if (!skip_depth && section_depth && sections_in_order)
+    section_builder.set_source(chars, len);
+}
+
+void
+pom_stream_rewriter::handle_utf8_content(unsigned long lineno, const char* chars, size_t len) {
+  if (skip_depth || !sections_in_order || ignorable_newlines(chars, len) >= 0)
+    return;
+  if (section_depth) {
+    if (section_builder.add_content(chars, len))
+      has_comment = false;
+  } else if (!streamed_sections.empty())
+    // text right inside a section being passed through: left to the whole-document rewrite
+    sections_in_order = false;
+}
+
+void
+pom_stream_rewriter::handle_utf8_comment(unsigned long lineno, const char* chars, size_t len) {
+  if (skip_depth || !sections_in_order)
+    return;
+  comment_buf.assign(chars, len);
+  has_comment = true;
+}
+}
@@ -0,0 +1,97 @@
+#ifndef POM_STREAM_H
+#define POM_STREAM_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "pom_stats.h"
+#include "rewrite_pom.h"
+#include "xml_graph.h"
+#include "xml_name.h"
+#include "xml_parser.h"
+#include "xml_scanner.h"
+#include "xml_writer.h"
+
+namespace pommade {
+
+// rewrites a POM while Xerces parses it, rather than after: the project, its build and its lists of plugins, profiles and modules
+// are passed through element by element, and only each section below them (the dependencies, the properties, one plugin...) is
+// built, rewritten and written on its own, so memory is bounded by the largest such section instead of the whole document; since
+// nothing can be taken back, this relies on the sections of the project and its build already being in canonical order, and gives
+// up on a document whose aren't (it must then be rewritten whole)
+class pom_stream_rewriter : private xml_parser::xml_utf8_handler {
+  enum class section_kind { project, build, plugins, profiles, modules };
+
+  // a section being passed through: its tags only get written once something inside it is, so that an empty one is dropped as the
+  // whole-document rewrite drops it
+  struct streamed_section {
+    section_kind kind;
+    xml_graph::xml_name name;
+    unsigned int level;
+    std::string comment;
+    bool has_comment;
+    bool gap_before;
+    bool has_subnodes;
+    bool written;
+    // project and build only: the slot of the last section in it so far, and the slots seen
+    int last_slot;
+    unsigned long seen_slots;
+
+    streamed_section(section_kind kind, xml_graph::xml_name name, unsigned int level, bool gap_before) : kind{kind}, name{name}, level{level}, has_comment{}, gap_before{gap_before}, has_subnodes{}, written{}, last_slot{-1}, seen_slots{} {}
+  };
+
+  pom_rewriter& rewriter;
+  xml_graph::xml_writer& writer;
+  xml_parser::xml_stream_parser parser;
+
+  std::vector<streamed_section> streamed_sections;
+  xml_graph::xml_doc_builder<xml_graph::xml_node> section_builder;
+  // the depth of the section being built (0 if none), and its slot in the section it's in (for a project or build)
+  unsigned int section_depth;
+  int section_slot;
+  // the depth of the element being skipped (0 if none), i.e. one the rewrite drops as unlisted
+  unsigned int skip_depth;
+  unsigned int depth;
+  std::string node_path;
+  std::string comment_buf;
+  bool has_comment;
+  bool sections_in_order;
+  std::size_t nodes;
+  pom_phase_stats rewrite_phase;
+  pom_phase_stats serialize_phase;
+
+  xml_graph::xml_text take_comment();
+  void stream_section(section_kind kind, xml_graph::xml_name name, bool gap_before);
+  void build_section(unsigned long lineno, xml_graph::xml_name name, int slot);
+  void end_built_section();
+  void end_streamed_section();
+  void write_streamed_sections();
+
+  void handle_utf8_start_document() override;
+  void handle_utf8_end_document(unsigned long lineno) override;
+  void handle_utf8_start_element(unsigned long lineno, const char* name, std::size_t len) override;
+  void handle_utf8_end_element(unsigned long lineno, const char* name, std::size_t len) override;
+  void handle_utf8_content(unsigned long lineno, const char* chars, std::size_t len) override;
+  void handle_utf8_comment(unsigned long lineno, const char* chars, std::size_t len) override;
+  void handle_utf8_processing_instruction(unsigned long lineno, const char* target, std::size_t target_len, const char* data, std::size_t data_len) override {}
+  void handle_utf8_element_source(const char* chars, std::size_t len) override;
+
+ public:
+  pom_stream_rewriter(pom_rewriter& rewriter, xml_graph::xml_writer& writer);
+
+  // starts on the caller's buffer (which must outlive the rewrite), appending to whatever writer holds
+  void start(const char* buf, std::size_t len, const char* system_id) { parser.start(buf, len, system_id); }
+  // rewrites as far as the next token; false once the document is done, or has turned out not to be in order; throws if it can't
+  // be parsed, or lists a section of its project or build twice
+  bool next();
+  void stop() { parser.stop(); }
+
+  bool in_order() const { return sections_in_order; }
+  std::size_t node_cnt() const { return nodes; }
+  // the time spent rewriting and writing sections, out of the whole
+  const pom_phase_stats& get_rewrite_phase() const { return rewrite_phase; }
+  const pom_phase_stats& get_serialize_phase() const { return serialize_phase; }
+};
+}
+#endif
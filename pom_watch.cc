@@ -0,0 +1,239 @@
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "pom_batch.h"
+#include "pom_watch.h"
+#include "rewrite_pom.h"
+#include "xml_name.h"
+
+namespace pommade {
+using namespace std;
+using xml_graph::xml_name;
+
+#ifdef __linux__
+namespace {
+using watch_clock = chrono::steady_clock;
+
+const chrono::milliseconds debounce_ms{150};
+const char* const pom_file_name = "pom.xml";
+
+// enough to tell whether a file has been written since it was last seen
+struct file_version {
+  ino_t ino;
+  off_t size;
+  timespec mtime;
+
+  bool operator==(const file_version& that) const { return ino == that.ino && size == that.size && mtime.tv_sec == that.mtime.tv_sec && mtime.tv_nsec == that.mtime.tv_nsec; }
+};
+
+bool
+get_file_version(const string& file, file_version& version) {
+  struct stat file_stat;
+  if (stat(file.c_str(), &file_stat))
+    return false;
+  version = file_version{file_stat.st_ino, file_stat.st_size, file_stat.st_mtim};
+  return true;
+}
+
+class tree_watcher {
+  const int fd;
+  unordered_map<int, string> watched_dirs;
+  // files written to, by when they have to have been left alone to be rewritten
+  map<string, watch_clock::time_point> pending_files;
+
+  void watch_dir(const string& dir, ostream& err, bool queue_pom);
+
+ public:
+  tree_watcher() : fd{inotify_init1(IN_CLOEXEC)} {}
+  ~tree_watcher() {
+    if (fd >= 0)
+      close(fd);
+  }
+
+  explicit operator bool() const { return fd >= 0; }
+
+  // with queue_poms, also queues the pom.xml in dir and in every directory below it (a tree that has just appeared may hold POMs
+  // written before its watches were set up)
+  void watch_tree(const string& dir, ostream& err, bool queue_poms = false);
+  // has a file rewritten again once it's been left alone for a while
+  void queue_file(const string& file) { pending_files[file] = watch_clock::now() + debounce_ms; }
+  // waits for (and notes) file events until some pending file's time has come, then hands back every path that's due: a pom.xml
+  // that has been written, or a pom.xml (or directory) that has gone
+  vector<string> wait_for_files(ostream& err);
+};
+
+void
+tree_watcher::watch_dir(const string& dir, ostream& err, bool queue_pom) {
+  // IN_MODIFY only postpones a pending rewrite: it's IN_CLOSE_WRITE (or a file moved into place, as editors save) that queues one;
+  // a file deleted or moved away is queued too, so that whatever was remembered about it can be forgotten
+  const int wd{inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR)};
+  if (wd < 0)
+    err << "can't watch '" << dir << "': " << strerror(errno) << endl;
+  else
+    watched_dirs[wd] = dir;
+  const string pom_file{dir + '/' + pom_file_name};
+  if (queue_pom && boost::filesystem::exists(pom_file))
+    pending_files[pom_file] = watch_clock::now() + debounce_ms;
+}
+
+void
+tree_watcher::watch_tree(const string& dir, ostream& err, bool queue_poms) {
+  watch_dir(dir, err, queue_poms);
+  boost::system::error_code ec;
+  for (boost::filesystem::recursive_directory_iterator it{dir, ec}, end; it != end; it.increment(ec)) {
+    if (ec)
+      break;
+    if (!boost::filesystem::is_directory(it->symlink_status()))
+      continue;
+    if (it->path().filename().string()[0] == '.')
+      it.no_push();
+    else
+      watch_dir(it->path().string(), err, queue_poms);
+  }
+}
+
+vector<string>
+tree_watcher::wait_for_files(ostream& err) {
+  alignas(inotify_event) char events[64 * 1024];
+  for (;;) {
+    int timeout_ms{-1};
+    if (!pending_files.empty()) {
+      auto due = pending_files.cbegin()->second;
+      for (const auto& pending_file : pending_files)
+        due = min(due, pending_file.second);
+      timeout_ms = static_cast<int>(max<chrono::milliseconds::rep>(chrono::duration_cast<chrono::milliseconds>(due - watch_clock::now()).count(), 0));
+    }
+    pollfd poll_fd{fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, timeout_ms) > 0) {
+      const ssize_t len{read(fd, events, sizeof events)};
+      for (ssize_t i{}; i < len;) {
+        const inotify_event* const event = reinterpret_cast<const inotify_event*>(events + i);
+        i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        if (event->mask & IN_Q_OVERFLOW)
+          err << "too many file events: some POMs may have been missed" << endl;
+        if (event->mask & IN_IGNORED)
+          watched_dirs.erase(event->wd);
+        const auto watched_dir = watched_dirs.find(event->wd);
+        if (watched_dir == watched_dirs.end() || !event->len)
+          continue;
+        const string path{watched_dir->second + '/' + event->name};
+        if (event->mask & IN_ISDIR) {
+          // POMs may have landed anywhere in a new directory tree before its watches were set up
+          if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && event->name[0] != '.')
+            watch_tree(path, err, true);
+          else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            pending_files[path] = watch_clock::now() + debounce_ms;
+        } else if (!strcmp(event->name, pom_file_name)) {
+          const auto pending_file = pending_files.find(path);
+          if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM))
+            pending_files[path] = watch_clock::now() + debounce_ms;
+          else if (pending_file != pending_files.end())
+            pending_file->second = watch_clock::now() + debounce_ms;
+        }
+      }
+    }
+
+    vector<string> due_files;
+    const auto now = watch_clock::now();
+    for (auto it = pending_files.begin(); it != pending_files.end();) {
+      if (it->second <= now) {
+        due_files.push_back(it->first);
+        it = pending_files.erase(it);
+      } else
+        ++it;
+    }
+    if (!due_files.empty())
+      return due_files;
+  }
+}
+}
+
+bool
+watch_tree(const string& dir, const vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, ostream& os, ostream& err) {
+  if (!boost::filesystem::is_directory(dir)) {
+    err << "can't watch '" << dir << "': not a directory" << endl;
+    return false;
+  }
+  tree_watcher watcher;
+  if (!watcher) {
+    err << "can't watch '" << dir << "': " << strerror(errno) << endl;
+    return false;
+  }
+  watcher.watch_tree(dir, err);
+
+  // a file's version is taken before it's read, and it's only replaced if it's still at that version just before the replacement is
+  // renamed over it: a file saved again meanwhile is left to be rewritten once more, from what was saved (and it's read into memory
+  // rather than mapped, as a save may truncate it under the parse)
+  file_version read_version;
+  file_version replaced_version;
+  bool replaced;
+  bool changed;
+  pom_batch_options watch_options{options};
+  watch_options.in_place = true;
+  watch_options.check = false;
+  watch_options.read_files = true;
+  watch_options.may_replace = [&read_version, &replaced_version, &replaced, &changed](const string& file, const string& replacement) {
+    file_version version;
+    changed = !get_file_version(file, version) || !(version == read_version);
+    // a rename keeps the replacement's version, so the file comes straight back as an event at this version
+    replaced = !changed && get_file_version(replacement, replaced_version);
+    return !changed;
+  };
+  pom_batch_rewriter batch_rewriter{preferred_artifacts, watch_options};
+  // files are only rewritten again once someone else wrote them: each file's version is remembered as it was read, or as it was
+  // replaced (and only until it's written again, or it or its directory goes)
+  unordered_map<string, file_version> rewritten_versions;
+  for (;;) {
+    for (const auto& file : watcher.wait_for_files(err)) {
+      if (!get_file_version(file, read_version)) {
+        const string dir_prefix{file + '/'};
+        for (auto it = rewritten_versions.begin(); it != rewritten_versions.end();) {
+          if (it->first == file || !it->first.compare(0, dir_prefix.size(), dir_prefix))
+            it = rewritten_versions.erase(it);
+          else
+            ++it;
+        }
+        continue;
+      }
+      const auto rewritten_version = rewritten_versions.find(file);
+      if (rewritten_version != rewritten_versions.end()) {
+        if (rewritten_version->second == read_version)
+          continue;
+        rewritten_versions.erase(rewritten_version);
+      }
+      replaced = changed = false;
+      batch_rewriter.rewrite_file(file, os, err);
+      if (changed)
+        watcher.queue_file(file);
+      else
+        rewritten_versions[file] = replaced ? replaced_version : read_version;
+    }
+    // no document outlives its rewrite, so the names met along the way can go, rather than piling up for as long as this runs
+    xml_name::release_dynamic();
+  }
+}
+#else
+bool
+watch_tree(const string& dir, const vector<pom_artifact_matcher>&, const pom_batch_options&, ostream&, ostream& err) {
+  err << "can't watch '" << dir << "': not supported on this platform" << endl;
+  return false;
+}
+#endif
+}
@@ -0,0 +1,18 @@
+#ifndef POM_WATCH_H
+#define POM_WATCH_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pom_batch.h"
+#include "rewrite_pom.h"
+
+namespace pommade {
+
+// watches dir (and every directory below it, bar hidden ones) and rewrites each pom.xml in place once it has been written and
+// then left alone for debounce_ms, reusing one warm pom_batch_rewriter; runs until killed, returning false only if the watch
+// can't be set up
+bool watch_tree(const std::string& dir, const std::vector<pom_artifact_matcher>& preferred_artifacts, const pom_batch_options& options, std::ostream& os, std::ostream& err);
+}
+#endif
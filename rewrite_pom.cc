@@ -1,8 +1,9 @@
 #include <algorithm>
 #include <cassert>
-#include <functional>
-#include <memory>
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -13,24 +14,179 @@ namespace pommade {
 using namespace std;
 using namespace xml_graph;
 
-const function<pom_xml_node(const xml_node&, bool)> pom_xml_node::copy_node_fn{[](const xml_node& node, bool gap_before) { return pom_xml_node{node, gap_before}; }};
+constexpr pom_xml_node (pom_rewriter::*const pom_rewriter::rw_fns[rw_key_cnt])(const xml_node&, bool);
+constexpr pom_xml_node (pom_rewriter::*const pom_rewriter::rw_with_flag_fns[rw_with_flag_key_cnt])(const xml_node&, bool, bool);
+constexpr pom_artifact_key (pom_rewriter::*const pom_rewriter::sort_key_fns[sort_key_cnt])(const xml_node&) const;
 
 bool
 pom_artifact::operator<(const pom_artifact& that) const {
   return group_id < that.group_id || (group_id == that.group_id && artifact_id < that.artifact_id);
 }
 
+namespace {
+// whether pattern, in which each '*' matches any run of characters, matches all of text; on a mismatch, only the last '*' is
+// backtracked to, which suffices since any earlier one could only have matched less
+bool
+glob_match(const char* pattern, size_t pattern_len, const char* text, size_t text_len) {
+  size_t p{}, t{};
+  size_t star_p{string::npos}, star_t{};
+  while (t < text_len) {
+    if (p < pattern_len && pattern[p] == '*') {
+      star_p = p++;
+      star_t = t;
+    } else if (p < pattern_len && pattern[p] == text[t]) {
+      ++p;
+      ++t;
+    } else if (star_p != string::npos) {
+      p = star_p + 1;
+      t = ++star_t;
+    } else
+      return false;
+  }
+  while (p < pattern_len && pattern[p] == '*')
+    ++p;
+  return p == pattern_len;
+}
+
+bool
+lt_trie_child(const pair<char, unsigned int>& child, char c) {
+  return child.first < c;
+}
+}
+
 bool
 pom_artifact_matcher::match(const pom_artifact& that) const {
-  if (group_id == that.group_id)
-    return artifact_id.empty() || artifact_id == that.artifact_id;
-  return false;
+  return match(xml_text{that.group_id.data(), that.group_id.size()}, xml_text{that.artifact_id.data(), that.artifact_id.size()});
 }
 
-pom_xml_node::pom_xml_node(const xml_node& node, bool gap_before) : basic_xml_node<pom_xml_node>{node.lineno, node.level, node.name, node.comment.get(), node.get_content()}, gap_before{gap_before} {
-  if (node.tree()) {
-    for (auto cit = node.tree()->cbegin(); cit != node.tree()->cend(); ++cit)
-      add_subnode(copy_node_fn(*cit, false));
+bool
+pom_artifact_matcher::match(const xml_text& that_group_id, const xml_text& that_artifact_id) const {
+  if (!glob_match(group_id.data(), group_id.size(), that_group_id.data(), that_group_id.size()))
+    return false;
+  return artifact_id.empty() || glob_match(artifact_id.data(), artifact_id.size(), that_artifact_id.data(), that_artifact_id.size());
+}
+
+// FNV-1a
+size_t
+pom_artifact_ranker::text_hash::operator()(const xml_text& text) const {
+  uint64_t hash{14695981039346656037ULL};
+  for (size_t i{}; i < text.size(); ++i) {
+    hash ^= static_cast<unsigned char>(text.data()[i]);
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+size_t
+pom_artifact_ranker::group_matchers::rank(const xml_text& artifact_id) const {
+  size_t first_rank{any_rank};
+  if (!artifact_ranks.empty()) {
+    const auto cit = artifact_ranks.find(artifact_id);
+    if (cit != artifact_ranks.cend())
+      first_rank = min(first_rank, cit->second);
+  }
+  // patterns were added in rank order
+  for (const auto& pattern : artifact_patterns) {
+    if (pattern.second >= first_rank)
+      break;
+    if (glob_match(pattern.first.data(), pattern.first.size(), artifact_id.data(), artifact_id.size()))
+      return pattern.second;
+  }
+  return first_rank;
+}
+
+pom_artifact_ranker::pom_artifact_ranker(const vector<pom_artifact_matcher>& matchers) : none_rank{matchers.size()}, prefix_trie(1) {
+  for (size_t rank{}; rank < matchers.size(); ++rank)
+    add(matchers[rank], rank);
+}
+
+void
+pom_artifact_ranker::add(const pom_artifact_matcher& matcher, size_t rank) {
+  const string& group_id = matcher.group_id;
+  const bool prefix{!group_id.empty() && group_id.back() == '*'};
+  const xml_text group_text{group_id.data(), group_id.size() - prefix};
+  size_t group_i;
+  if (prefix) {
+    unsigned int node_i{};
+    for (size_t i{}; i < group_text.size(); ++i) {
+      auto& children = prefix_trie[node_i].children;
+      auto it = lower_bound(children.begin(), children.end(), group_text.data()[i], lt_trie_child);
+      if (it == children.end() || it->first != group_text.data()[i])
+        it = children.emplace(it, group_text.data()[i], static_cast<unsigned int>(prefix_trie.size()));
+      node_i = it->second;
+      // children is only invalidated once it's no longer needed
+      if (node_i == prefix_trie.size())
+        prefix_trie.emplace_back();
+    }
+    if (prefix_trie[node_i].group < 0) {
+      prefix_trie[node_i].group = static_cast<int>(groups.size());
+      groups.emplace_back(none_rank);
+    }
+    group_i = static_cast<size_t>(prefix_trie[node_i].group);
+  } else {
+    const auto inserted = exact_groups.emplace(group_text, static_cast<unsigned int>(groups.size()));
+    if (inserted.second)
+      groups.emplace_back(none_rank);
+    group_i = inserted.first->second;
+  }
+
+  // an artifact already matched by an earlier matcher keeps its rank
+  group_matchers& group = groups[group_i];
+  const string& artifact_id = matcher.artifact_id;
+  if (artifact_id.empty())
+    group.any_rank = min(group.any_rank, rank);
+  else if (artifact_id.find('*') == string::npos)
+    group.artifact_ranks.emplace(xml_text{artifact_id.data(), artifact_id.size()}, rank);
+  else
+    group.artifact_patterns.emplace_back(xml_text{artifact_id.data(), artifact_id.size()}, rank);
+}
+
+size_t
+pom_artifact_ranker::rank(const xml_text& group_id, const xml_text& artifact_id) const {
+  size_t first_rank{none_rank};
+  const auto cit = exact_groups.find(group_id);
+  if (cit != exact_groups.cend())
+    first_rank = groups[cit->second].rank(artifact_id);
+  // every listed prefix of the groupId (the empty one included) is on the path to it from the trie's root
+  unsigned int node_i{};
+  for (size_t i{};; ++i) {
+    const trie_node& node = prefix_trie[node_i];
+    if (node.group >= 0)
+      first_rank = min(first_rank, groups[static_cast<size_t>(node.group)].rank(artifact_id));
+    if (i == group_id.size())
+      break;
+    const auto it = lower_bound(node.children.cbegin(), node.children.cend(), group_id.data()[i], lt_trie_child);
+    if (it == node.children.cend() || it->first != group_id.data()[i])
+      break;
+    node_i = it->second;
+  }
+  return first_rank;
+}
+
+bool
+pom_artifact_key::operator<(const pom_artifact_key& that) const {
+  if (rank != that.rank)
+    return rank < that.rank;
+  const int cmp{group_id.compare(that.group_id)};
+  return cmp < 0 || (!cmp && artifact_id < that.artifact_id);
+}
+
+// a node whose bytes the parser kept is written as those, attributes and formatting included, with nothing below it copied;
+// otherwise node's descendants follow it in document order, so each is copied in turn below the copy of the innermost node whose
+// span it's in, rather than recursively: configuration blocks can nest arbitrarily deep
+pom_xml_node::pom_xml_node(const xml_node& node, bool gap_before) : basic_xml_node<pom_xml_node>{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content()}, gap_before{gap_before} {
+  if (node.get_source()) {
+    set_source(node.get_source().data(), node.get_source().size());
+    return;
+  }
+  vector<pair<pom_xml_node*, const xml_node*>> open_copies{{this, &node}};
+  const xml_node* const end{&node + node.get_span()};
+  for (const xml_node* nodep{&node + 1}; nodep != end; ++nodep) {
+    while (nodep == open_copies.back().second + open_copies.back().second->get_span())
+      open_copies.pop_back();
+    pom_xml_node* const copyp{open_copies.back().first->add_subnode(pom_xml_node{nodep->get_arena(), nodep->lineno, nodep->level, nodep->name, nodep->comment, nodep->get_content(), false})};
+    if (nodep->tree())
+      open_copies.emplace_back(copyp, nodep);
   }
 }
 
@@ -39,13 +195,18 @@ pom_artifact_matcher::parse(const string& pom_artifact_matcher_spec) {
   const auto pos = pom_artifact_matcher_spec.find(':');
   if (pos == 0)
     throw invalid_argument{string{"empty groupId in pom-artifact spec '"} + pom_artifact_matcher_spec + '\''};
+  const string group_id{pom_artifact_matcher_spec.substr(0, pos)};
+  const auto star_pos = group_id.find('*');
+  if (star_pos != string::npos && star_pos + 1 < group_id.size())
+    throw invalid_argument{string{"'*' before the end of the groupId in pom-artifact spec '"} + pom_artifact_matcher_spec + '\''};
   if (pos == string::npos)
-    return pom_artifact_matcher{pom_artifact_matcher_spec};
-  return pom_artifact_matcher{pom_artifact_matcher_spec.substr(0, pos), pom_artifact_matcher_spec.substr(pos + 1)};
+    return pom_artifact_matcher{group_id};
+  return pom_artifact_matcher{group_id, pom_artifact_matcher_spec.substr(pos + 1)};
 }
 
+template <typename RwFn>
 bool
-pom_rewriter::add_nonempty_rewrite_node(pom_xml_node& node, bool gap_before, const xml_node* subnode, const function<pom_xml_node(const xml_node&, bool)>& rw_fn) {
+pom_rewriter::add_nonempty_rewrite_node(pom_xml_node& node, bool gap_before, const xml_node* subnode, const RwFn& rw_fn) {
   if (subnode) {
     pom_xml_node rw_subnode{rw_fn(*subnode, gap_before)};
     if (rw_subnode.get_content() || rw_subnode.tree()) {
@@ -56,9 +217,10 @@ pom_rewriter::add_nonempty_rewrite_node(pom_xml_node& node, bool gap_before, con
   return false;
 }
 
+template <typename RwFn>
 pom_xml_node
-pom_rewriter::rewrite_subnodes(const xml_node& node, bool gap_before, bool gap_before_subnodes, const function<pom_xml_node(const xml_node&, bool)>& rw_fn) {
-  pom_xml_node rw_node{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+pom_rewriter::rewrite_subnodes(const xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn) {
+  pom_xml_node rw_node{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   if (node.tree()) {
     for (auto cit = node.tree()->cbegin(); cit != node.tree()->cend(); ++cit)
       rw_node.add_subnode(rw_fn(*cit, cit == node.tree()->cbegin() ? false : gap_before_subnodes));
@@ -66,21 +228,41 @@ pom_rewriter::rewrite_subnodes(const xml_node& node, bool gap_before, bool gap_b
   return rw_node;
 }
 
+template <typename RwFn, typename LtFn>
 pom_xml_node
-pom_rewriter::rewrite_sort_subnodes(const xml_node& node, bool gap_before, bool gap_before_subnodes, const function<pom_xml_node(const xml_node&, bool)>& rw_fn, const function<bool(const xml_node*, const xml_node*)>& lt_fn) {
-  pom_xml_node rw_node{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+pom_rewriter::rewrite_sort_subnodes(const xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn, const LtFn& lt_fn) {
+  pom_xml_node rw_node{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   if (node.tree()) {
     vector<const xml_node*> subnodeps;
     for (auto cit = node.tree()->cbegin(); cit != node.tree()->cend(); ++cit)
       subnodeps.push_back(&*cit);
     sort(subnodeps.begin(), subnodeps.end(), lt_fn);
-    vector<unique_ptr<const pom_xml_node>> pom_subnodes;
     bool gap_before_subnode{};
     for (auto nodep : subnodeps) {
-      pom_subnodes.push_back(unique_ptr<const pom_xml_node>{new pom_xml_node{rw_fn(*nodep, gap_before_subnode)}});
+      rw_node.add_subnode(rw_fn(*nodep, gap_before_subnode));
+      gap_before_subnode = gap_before_subnodes;
+    }
+  }
+  return rw_node;
+}
+
+// like rewrite_sort_subnodes, but each subnode's sort key is built just once rather than on every comparison
+template <typename RwFn, typename KeyFn>
+pom_xml_node
+pom_rewriter::rewrite_key_sort_subnodes(const xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn, const KeyFn& key_fn) {
+  pom_xml_node rw_node{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
+  if (node.tree()) {
+    using keyed_nodep = pair<decltype(key_fn(node)), const xml_node*>;
+    vector<keyed_nodep> keyed_subnodeps;
+    keyed_subnodeps.reserve(node.tree()->node_cnt());
+    for (auto cit = node.tree()->cbegin(); cit != node.tree()->cend(); ++cit)
+      keyed_subnodeps.emplace_back(key_fn(*cit), &*cit);
+    sort(keyed_subnodeps.begin(), keyed_subnodeps.end(), [](const keyed_nodep& a, const keyed_nodep& b) { return a.first < b.first; });
+    bool gap_before_subnode{};
+    for (const auto& keyed_subnodep : keyed_subnodeps) {
+      rw_node.add_subnode(rw_fn(*keyed_subnodep.second, gap_before_subnode));
       gap_before_subnode = gap_before_subnodes;
     }
-    rw_node.add_subnodes(move(pom_subnodes));
   }
   return rw_node;
 }
@@ -88,7 +270,7 @@ pom_rewriter::rewrite_sort_subnodes(const xml_node& node, bool gap_before, bool
 pom_xml_node
 pom_rewriter::rewrite_leaf_node(const xml_node& node, bool gap_before) {
   assert(node.get_content() && !node.tree());
-  return pom_xml_node{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  return pom_xml_node{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
 }
 
 pom_xml_node
@@ -107,10 +289,10 @@ pom_xml_node
 pom_rewriter::rewrite_parent_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
 
-  const vector<const xml_node*> parent_tree{node.tree()->find_in({"groupId", "artifactId", "version", "relativePath"})};
-  assert(parent_tree.size() == 4 && parent_tree[0] && parent_tree[1] && parent_tree[2]);
+  const auto parent_tree = xml_subnode_classifier<xml_names::group_id, xml_names::artifact_id, xml_names::version, xml_names::relative_path>::classify(node);
+  assert(!parent_tree.duplicate_cnt() && parent_tree[0] && parent_tree[1] && parent_tree[2]);
 
-  pom_xml_node rw_parent{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_parent{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_parent.add_subnode(rewrite_leaf_node(*parent_tree[0], false));
   rw_parent.add_subnode(rewrite_leaf_node(*parent_tree[1], false));
   rw_parent.add_subnode(rewrite_leaf_node(*parent_tree[2], false));
@@ -123,10 +305,10 @@ pom_xml_node
 pom_rewriter::rewrite_distribution_management_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree() && node.tree()->node_cnt() <= 2);
 
-  const vector<const xml_node*> distribution_management_tree{node.tree()->find_in(vector<const char*>{"repository", "snapshotRepository"})};
-  assert(distribution_management_tree.size() == 2);
+  const auto distribution_management_tree = xml_subnode_classifier<xml_names::repository, xml_names::snapshot_repository>::classify(node);
+  assert(!distribution_management_tree.duplicate_cnt());
 
-  pom_xml_node rw_distribution_management{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_distribution_management{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   add_nonempty_rewrite_node(rw_distribution_management, false, distribution_management_tree[0], rewrite_leaf_subnodes_by_name);
   add_nonempty_rewrite_node(rw_distribution_management, false, distribution_management_tree[1], rewrite_leaf_subnodes_by_name);
 
@@ -135,12 +317,12 @@ pom_rewriter::rewrite_distribution_management_node(const xml_node& node, bool ga
 
 pom_xml_node
 pom_rewriter::rewrite_exclusion_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "exclusion" && !node.get_content() && node.tree() && node.tree()->node_cnt() >= 1);
+  assert(node.name == xml_names::exclusion && !node.get_content() && node.tree() && node.tree()->node_cnt() >= 1);
 
-  const vector<const xml_node*> exclusion_tree{node.tree()->find_in(vector<const char*>{"groupId", "artifactId"})};
-  assert(exclusion_tree.size() == 2 && exclusion_tree[0]);
+  const auto exclusion_tree = xml_subnode_classifier<xml_names::group_id, xml_names::artifact_id>::classify(node);
+  assert(!exclusion_tree.duplicate_cnt() && exclusion_tree[0]);
 
-  pom_xml_node rw_exclusion{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_exclusion{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_exclusion.add_subnode(rewrite_leaf_node(*exclusion_tree[0], false));
   add_nonempty_rewrite_node(rw_exclusion, false, exclusion_tree[1], rewrite_leaf_node);
 
@@ -149,39 +331,39 @@ pom_rewriter::rewrite_exclusion_node(const xml_node& node, bool gap_before) {
 
 pom_xml_node
 pom_rewriter::rewrite_exclusions_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "exclusions" && !node.get_content());
-  return rewrite_sort_subnodes(node, gap_before, false, get_rw_fn(rw_exclusion), get_lt_fn(lt_artifact));
+  assert(node.name == xml_names::exclusions && !node.get_content());
+  return rewrite_key_sort_subnodes(node, gap_before, false, get_rw_fn<rw_exclusion>(), get_sort_key_fn<sort_by_artifact>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_dependency_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "dependency" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 6);
+  assert(node.name == xml_names::dependency && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 6);
 
-  const vector<const xml_node*> dependency_tree{node.tree()->find_in(vector<const char*>{"groupId", "artifactId", "version", "packaging", "scope", "exclusions"})};
-  assert(dependency_tree.size() == 6 && dependency_tree[0] && dependency_tree[1]);
+  const auto dependency_tree = xml_subnode_classifier<xml_names::group_id, xml_names::artifact_id, xml_names::version, xml_names::packaging, xml_names::scope, xml_names::exclusions>::classify(node);
+  assert(!dependency_tree.duplicate_cnt() && dependency_tree[0] && dependency_tree[1]);
 
-  pom_xml_node rw_dependency{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_dependency{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_dependency.add_subnode(rewrite_leaf_node(*dependency_tree[0], false));
   rw_dependency.add_subnode(rewrite_leaf_node(*dependency_tree[1], false));
   add_nonempty_rewrite_node(rw_dependency, false, dependency_tree[2], rewrite_leaf_node);
   add_nonempty_rewrite_node(rw_dependency, false, dependency_tree[3], rewrite_leaf_node);
   add_nonempty_rewrite_node(rw_dependency, false, dependency_tree[4], rewrite_leaf_node);
-  add_nonempty_rewrite_node(rw_dependency, false, dependency_tree[5], get_rw_fn(rw_exclusions));
+  add_nonempty_rewrite_node(rw_dependency, false, dependency_tree[5], get_rw_fn<rw_exclusions>());
 
   return rw_dependency;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_dependencies_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "dependencies" && !node.get_content());
-  return rewrite_sort_subnodes(node, gap_before, true, get_rw_fn(rw_dependency), get_lt_fn(lt_artifact));
+  assert(node.name == xml_names::dependencies && !node.get_content());
+  return rewrite_key_sort_subnodes(node, gap_before, true, get_rw_fn<rw_dependency>(), get_sort_key_fn<sort_by_artifact>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_dependency_management_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content());
 
-  pom_xml_node rw_dependency_management{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_dependency_management{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   if (!node.tree())
     return rw_dependency_management;
 
@@ -192,18 +374,18 @@ pom_rewriter::rewrite_dependency_management_node(const xml_node& node, bool gap_
 
 pom_xml_node
 pom_rewriter::rewrite_property_node(const xml_node& node, bool gap_before, bool unvalued_ok) {
-  assert(node.name == "property" && !node.get_content() && node.tree());
+  assert(node.name == xml_names::property && !node.get_content() && node.tree());
   if (unvalued_ok)
     assert(node.tree()->node_cnt() <= 2);
   else
     assert(node.tree()->node_cnt() == 2);
 
-  const vector<const xml_node*> property_tree{node.tree()->find_in(vector<const char*>{"name", "value"})};
-  assert(property_tree.size() == 2 && property_tree[0]);
+  const auto property_tree = xml_subnode_classifier<xml_names::name, xml_names::value>::classify(node);
+  assert(!property_tree.duplicate_cnt() && property_tree[0]);
   if (!unvalued_ok)
     assert(property_tree[1]);
 
-  pom_xml_node rw_property{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_property{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_property.add_subnode(rewrite_leaf_node(*property_tree[0], false));
   if (!unvalued_ok)
     rw_property.add_subnode(rewrite_leaf_node(*property_tree[1], false));
@@ -216,9 +398,9 @@ pom_rewriter::rewrite_property_node(const xml_node& node, bool gap_before, bool
 pom_xml_node
 pom_rewriter::rewrite_properties_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
-  return rewrite_sort_subnodes(node, gap_before, false, get_rw_with_flag_fn(rw_with_flag_key{rw_with_flag_property, false}), [](const xml_node* a, const xml_node* b) {
+  return rewrite_sort_subnodes(node, gap_before, false, get_rw_with_flag_fn<rw_with_flag_property, false>(), [](const xml_node* a, const xml_node* b) {
     auto a_cit = a->tree()->cbegin(), b_cit = b->tree()->cbegin();
-    return *a_cit->get_content() < *b_cit->get_content();
+    return a_cit->get_content() < b_cit->get_content();
   });
 }
 
@@ -226,36 +408,36 @@ pom_xml_node
 pom_rewriter::rewrite_activation_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
 
-  const vector<const xml_node*> activation_tree{node.tree()->find_in(vector<const char*>{"activeByDefault", "property"})};
-  assert(activation_tree.size() >= 2);
+  const auto activation_tree = xml_subnode_classifier<xml_names::active_by_default, xml_names::property>::classify(node);
 
-  pom_xml_node rw_activation{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_activation{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   add_nonempty_rewrite_node(rw_activation, false, activation_tree[0], rewrite_leaf_node);
-  if (activation_tree[1]) {
-    for (auto i = 1U; i < activation_tree.size(); ++i)
-      rw_activation.add_subnode(rewrite_property_node(*activation_tree[i], false));
-  }
+  for (const auto property_nodep : activation_tree.all(1))
+    rw_activation.add_subnode(rewrite_property_node(*property_nodep, false));
   return rw_activation;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_configuration_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
-  return rewrite_sort_subnodes(node, gap_before, false, (node.name == "properties" ? get_rw_fn(rw_properties) : pom_xml_node::copy_node_fn), [](const xml_node* a, const xml_node* b) { return a->name == "properties" || a->name < b->name; });
+  const auto lt_fn = [](const xml_node* a, const xml_node* b) { return a->name == xml_names::properties || a->name < b->name; };
+  if (node.name == xml_names::properties)
+    return rewrite_sort_subnodes(node, gap_before, false, get_rw_fn<rw_properties>(), lt_fn);
+  return rewrite_sort_subnodes(node, gap_before, false, pom_xml_node::copy_node, lt_fn);
 }
 
 pom_xml_node
 pom_rewriter::rewrite_execution_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "execution" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
+  assert(node.name == xml_names::execution && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
 
-  const vector<const xml_node*> execution_tree{node.tree()->find_in(vector<const char*>{"id", "phase", "goals", "configuration"})};
-  assert(execution_tree.size() == 4 && execution_tree[2]);
+  const auto execution_tree = xml_subnode_classifier<xml_names::id, xml_names::phase, xml_names::goals, xml_names::configuration>::classify(node);
+  assert(!execution_tree.duplicate_cnt() && execution_tree[2]);
 
-  pom_xml_node rw_execution{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_execution{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   add_nonempty_rewrite_node(rw_execution, false, execution_tree[0], rewrite_leaf_node);
   add_nonempty_rewrite_node(rw_execution, false, execution_tree[1], rewrite_leaf_node);
   rw_execution.add_subnode(rewrite_leaf_subnodes(*execution_tree[2], false));
-  add_nonempty_rewrite_node(rw_execution, false, execution_tree[3], get_rw_fn(rw_configuration));
+  add_nonempty_rewrite_node(rw_execution, false, execution_tree[3], get_rw_fn<rw_configuration>());
 
   return rw_execution;
 }
@@ -263,46 +445,46 @@ pom_rewriter::rewrite_execution_node(const xml_node& node, bool gap_before) {
 pom_xml_node
 pom_rewriter::rewrite_executions_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
-  return rewrite_subnodes(node, gap_before, false, get_rw_fn(rw_execution));
+  return rewrite_subnodes(node, gap_before, false, get_rw_fn<rw_execution>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_plugin_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "plugin" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 5);
+  assert(node.name == xml_names::plugin && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 5);
 
-  const vector<const xml_node*> plugin_tree{node.tree()->find_in(vector<const char*>{"groupId", "artifactId", "version", "configuration", "executions"})};
-  assert(plugin_tree.size() == 5 && plugin_tree[1]);
+  const auto plugin_tree = xml_subnode_classifier<xml_names::group_id, xml_names::artifact_id, xml_names::version, xml_names::configuration, xml_names::executions>::classify(node);
+  assert(!plugin_tree.duplicate_cnt() && plugin_tree[1]);
 
-  pom_xml_node rw_plugin{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_plugin{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[0], rewrite_leaf_node);
   rw_plugin.add_subnode(rewrite_leaf_node(*plugin_tree[1], false));
   add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[2], rewrite_leaf_node);
-  add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[3], get_rw_fn(rw_configuration));
-  add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[4], get_rw_fn(rw_executions));
+  add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[3], get_rw_fn<rw_configuration>());
+  add_nonempty_rewrite_node(rw_plugin, false, plugin_tree[4], get_rw_fn<rw_executions>());
 
   return rw_plugin;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_plugins_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "plugins" && !node.get_content());
-  return rewrite_subnodes(node, gap_before, true, get_rw_fn(rw_plugin));
+  assert(node.name == xml_names::plugins && !node.get_content());
+  return rewrite_subnodes(node, gap_before, true, get_rw_fn<rw_plugin>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_plugin_management_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree() && node.tree()->node_cnt() == 1);
-  return rewrite_subnodes(node, gap_before, true, get_rw_fn(rw_plugins));
+  return rewrite_subnodes(node, gap_before, true, get_rw_fn<rw_plugins>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_resource_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "resource" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
+  assert(node.name == xml_names::resource && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
 
-  const vector<const xml_node*> resource_tree{node.tree()->find_in(vector<const char*>{"directory", "filtering", "includes", "excludes"})};
-  assert(resource_tree.size() == 4 && resource_tree[0]);
+  const auto resource_tree = xml_subnode_classifier<xml_names::directory, xml_names::filtering, xml_names::includes, xml_names::excludes>::classify(node);
+  assert(!resource_tree.duplicate_cnt() && resource_tree[0]);
 
-  pom_xml_node rw_resource{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_resource{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_resource.add_subnode(rewrite_leaf_node(*resource_tree[0], false));
   add_nonempty_rewrite_node(rw_resource, false, resource_tree[1], rewrite_leaf_node);
   add_nonempty_rewrite_node(rw_resource, false, resource_tree[2], rewrite_leaf_subnodes);
@@ -314,36 +496,52 @@ pom_rewriter::rewrite_resource_node(const xml_node& node, bool gap_before) {
 pom_xml_node
 pom_rewriter::rewrite_resources_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
-  return rewrite_subnodes(node, gap_before, false, get_rw_fn(rw_resource));
+  return rewrite_subnodes(node, gap_before, false, get_rw_fn<rw_resource>());
+}
+
+bool
+pom_rewriter::add_build_section(pom_xml_node& rw_build, size_t slot, const xml_node* node) {
+  switch (slot) {
+  case build_plugin_management:
+    return add_nonempty_rewrite_node(rw_build, false, node, get_rw_fn<rw_plugin_management>());
+  case build_plugins:
+    // set apart from the plugin management before it, if any
+    return add_nonempty_rewrite_node(rw_build, rw_build.tree() != nullptr, node, get_rw_fn<rw_plugins>());
+  case build_resources:
+    return add_nonempty_rewrite_node(rw_build, true, node, get_rw_fn<rw_resources>());
+  }
+  assert(false);
+  return false;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_build_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "build" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 3);
+  assert(node.name == xml_names::build && !node.get_content() && node.tree());
 
-  const vector<const xml_node*> build_tree{node.tree()->find_in({"pluginManagement", "plugins", "resources"})};
-  assert(build_tree.size() == 3);
+  const auto build_tree = build_classifier::classify(node);
+  if (const xml_node* const duplicate = build_tree.first_duplicate())
+    fail_duplicate_section(duplicate->name, node.name, duplicate->lineno);
+  assert(node.tree()->node_cnt() <= 3);
 
-  pom_xml_node rw_build{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
-  const bool has_plugin_management = add_nonempty_rewrite_node(rw_build, false, build_tree[0], get_rw_fn(rw_plugin_management));
-  add_nonempty_rewrite_node(rw_build, has_plugin_management, build_tree[1], get_rw_fn(rw_plugins));
-  add_nonempty_rewrite_node(rw_build, true, build_tree[2], get_rw_fn(rw_resources));
+  pom_xml_node rw_build{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
+  for (size_t slot{}; slot < build_slot_cnt; ++slot)
+    add_build_section(rw_build, slot, build_tree[slot]);
 
   return rw_build;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_profile_node(const xml_node& node, bool gap_before) {
-  assert(node.name == "profile" && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
+  assert(node.name == xml_names::profile && !node.get_content() && node.tree() && node.tree()->node_cnt() <= 4);
 
-  const vector<const xml_node*> profile_tree{node.tree()->find_in({"id", "properties", "activation", "build"})};
-  assert(profile_tree.size() == 4 && profile_tree[0]);
+  const auto profile_tree = xml_subnode_classifier<xml_names::id, xml_names::properties, xml_names::activation, xml_names::build>::classify(node);
+  assert(!profile_tree.duplicate_cnt() && profile_tree[0]);
 
-  pom_xml_node rw_profile{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), gap_before};
+  pom_xml_node rw_profile{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), gap_before};
   rw_profile.add_subnode(rewrite_leaf_node(*profile_tree[0], false));
   add_nonempty_rewrite_node(rw_profile, false, profile_tree[1], rewrite_leaf_subnodes_by_name);
-  add_nonempty_rewrite_node(rw_profile, false, profile_tree[2], get_rw_fn(rw_activation));
-  add_nonempty_rewrite_node(rw_profile, false, profile_tree[3], get_rw_fn(rw_build));
+  add_nonempty_rewrite_node(rw_profile, false, profile_tree[2], get_rw_fn<rw_activation>());
+  add_nonempty_rewrite_node(rw_profile, false, profile_tree[3], get_rw_fn<rw_build>());
 
   return rw_profile;
 }
@@ -351,81 +549,119 @@ pom_rewriter::rewrite_profile_node(const xml_node& node, bool gap_before) {
 pom_xml_node
 pom_rewriter::rewrite_profiles_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content());
-  return rewrite_subnodes(node, gap_before, true, get_rw_fn(rw_profile));
+  return rewrite_subnodes(node, gap_before, true, get_rw_fn<rw_profile>());
+}
+
+pom_xml_node
+pom_rewriter::rewrite_module_node(const xml_node& node, bool gap_before) {
+  if (node.name == xml_names::module && node.get_content()) {
+    // a path, surrounding whitespace aside
+    const string path{node.get_content().str()};
+    const auto first = path.find_first_not_of(" \t\r\n"), last = path.find_last_not_of(" \t\r\n");
+    if (first != string::npos)
+      modules.push_back(path.substr(first, last - first + 1));
+  }
+  return rewrite_leaf_node(node, gap_before);
+}
+
+// the reactor builds modules in the order listed (dependencies between them aside), so they're left in that order
+pom_xml_node
+pom_rewriter::rewrite_modules_node(const xml_node& node, bool gap_before) {
+  assert(node.name == xml_names::modules && !node.get_content());
+  return rewrite_subnodes(node, gap_before, false, get_rw_fn<rw_module>());
 }
 
 pom_xml_node
 pom_rewriter::rewrite_active_profiles_node(const xml_node& node, bool gap_before) {
   assert(!node.get_content() && node.tree());
-  return rewrite_sort_subnodes(node, gap_before, false, rewrite_leaf_node, [](const xml_node* a, const xml_node* b) { return *a->get_content() < *b->get_content(); });
+  return rewrite_sort_subnodes(node, gap_before, false, rewrite_leaf_node, [](const xml_node* a, const xml_node* b) { return a->get_content() < b->get_content(); });
+}
+
+bool
+pom_rewriter::add_project_section(pom_xml_node& rw_project, size_t slot, const xml_node* node) {
+  switch (slot) {
+  case project_model_version:
+  case project_artifact_id:
+    assert(node);
+    rw_project.add_subnode(rewrite_leaf_node(*node, false));
+    return true;
+  case project_parent:
+    return has_parent = add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_parent>());
+  case project_group_id:
+  case project_version:
+  case project_packaging:
+    return add_nonempty_rewrite_node(rw_project, false, node, rewrite_leaf_node);
+  case project_properties:
+  case project_scm:
+    return add_nonempty_rewrite_node(rw_project, true, node, rewrite_leaf_subnodes_by_name);
+  case project_distribution_management:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_distribution_management>());
+  case project_dependency_management:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_dependency_management>());
+  case project_dependencies:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_dependencies>());
+  case project_build:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_build>());
+  case project_modules:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_modules>());
+  case project_profiles:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_profiles>());
+  case project_active_profiles:
+    return add_nonempty_rewrite_node(rw_project, true, node, get_rw_fn<rw_active_profiles>());
+  }
+  assert(false);
+  return false;
+}
+
+void
+pom_rewriter::fail_duplicate_section(const xml_name& name, const xml_name& owner_name, unsigned int lineno) {
+  throw runtime_error{"duplicate '" + name.str() + "' in '" + owner_name.str() + "'; line " + to_string(lineno)};
 }
 
 pom_xml_node
 pom_rewriter::rewrite_project_node(const xml_node& node) {
-  assert(!node.get_content() && node.tree() && node.tree()->node_cnt() <= 15);
-
-  const vector<const xml_node*> project_tree{node.tree()->find_in({"modelVersion", "parent", "groupId", "artifactId", "version", "packaging", "properties", "scm", "distributionManagement", "dependencyManagement", "dependencies", "build", "modules", "profiles", "activeProfiles"})};
-  assert(project_tree.size() == 15 && project_tree[0] && project_tree[3]);
-
-  pom_xml_node rw_project{node.lineno, node.level, node.name, node.comment.get(), node.get_content(), false};
-  rw_project.add_subnode(rewrite_leaf_node(*project_tree[0], false));
-  has_parent = add_nonempty_rewrite_node(rw_project, true, project_tree[1], get_rw_fn(rw_parent));
-  add_nonempty_rewrite_node(rw_project, false, project_tree[2], rewrite_leaf_node);
-  rw_project.add_subnode(rewrite_leaf_node(*project_tree[3], false));
-  add_nonempty_rewrite_node(rw_project, false, project_tree[4], rewrite_leaf_node);
-  add_nonempty_rewrite_node(rw_project, false, project_tree[5], rewrite_leaf_node);
-  add_nonempty_rewrite_node(rw_project, true, project_tree[6], rewrite_leaf_subnodes_by_name);
-  add_nonempty_rewrite_node(rw_project, true, project_tree[7], rewrite_leaf_subnodes_by_name);
-  add_nonempty_rewrite_node(rw_project, true, project_tree[8], get_rw_fn(rw_distribution_management));
-  add_nonempty_rewrite_node(rw_project, true, project_tree[9], get_rw_fn(rw_dependency_management));
-  add_nonempty_rewrite_node(rw_project, true, project_tree[10], get_rw_fn(rw_dependencies));
-  add_nonempty_rewrite_node(rw_project, true, project_tree[11], get_rw_fn(rw_build));
-  add_nonempty_rewrite_node(rw_project, true, project_tree[12], rewrite_leaf_subnodes);
-  add_nonempty_rewrite_node(rw_project, true, project_tree[13], get_rw_fn(rw_profiles));
-  add_nonempty_rewrite_node(rw_project, true, project_tree[14], get_rw_fn(rw_active_profiles));
+  assert(!node.get_content() && node.tree());
+
+  const auto project_tree = project_classifier::classify(node);
+  if (const xml_node* const duplicate = project_tree.first_duplicate())
+    fail_duplicate_section(duplicate->name, node.name, duplicate->lineno);
+  assert(node.tree()->node_cnt() <= 15 && project_tree[project_model_version] && project_tree[project_artifact_id]);
+
+  pom_xml_node rw_project{node.get_arena(), node.lineno, node.level, node.name, node.comment, node.get_content(), false};
+  for (size_t slot{}; slot < project_slot_cnt; ++slot)
+    add_project_section(rw_project, slot, project_tree[slot]);
 
   return rw_project;
 }
 
-pom_artifact
-pom_rewriter::build_pom_artifact(const xml_node& node) {
+pom_artifact_key
+pom_rewriter::build_pom_artifact_key(const xml_node& node) const {
   assert(node.tree());
-  pom_artifact artifact{};
+  pom_artifact_key key{};
   const auto cend = node.tree()->cend();
   // can't assume that subnodes are sorted!
   for (auto cit = node.tree()->cbegin(); cit != cend; ++cit) {
-    if (cit->name == "groupId" && cit->get_content()) {
-      artifact.group_id = *cit->get_content();
-      if (!artifact.artifact_id.empty())
+    if (cit->name == xml_names::group_id && cit->get_content()) {
+      key.group_id = cit->get_content();
+      if (key.artifact_id.size())
         break;
     }
-    if (cit->name == "artifactId" && cit->get_content()) {
-      artifact.artifact_id = *cit->get_content();
-      if (!artifact.group_id.empty())
+    if (cit->name == xml_names::artifact_id && cit->get_content()) {
+      key.artifact_id = cit->get_content();
+      if (key.group_id.size())
         break;
     }
   }
-  return artifact;
-}
-
-bool
-pom_rewriter::lt_artifact_nodes(const xml_node* a, const xml_node* b) const {
-  const pom_artifact a_artifact{build_pom_artifact(*a)}, b_artifact{build_pom_artifact(*b)};
-  for (const auto& preferred_artifact : preferred_artifacts) {
-    const bool a_match{preferred_artifact.match(a_artifact)}, b_match{preferred_artifact.match(b_artifact)};
-    if (a_match && b_match)
-      return a_artifact < b_artifact;
-    if (a_match != b_match)
-      return a_match;
-  }
-  return a_artifact < b_artifact;
+  key.rank = preferred_artifacts.rank(key.group_id, key.artifact_id);
+  return key;
 }
 
 pom_xml_node
 pom_rewriter::rewrite_pom(const xml_node* node) {
   assert(node);
-  if (node->name != "project" || !node->tree())
+  if (node->name != xml_names::project || !node->tree())
     throw runtime_error{"root project node missing or empty"};
+  start_project();
   return rewrite_project_node(*node);
 }
 }
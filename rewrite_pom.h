@@ -1,9 +1,11 @@
 #ifndef REWRITE_POM_H
 #define REWRITE_POM_H
 
-#include <functional>
+#include <cstddef>
 #include <ostream>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "pom_rewriter_fns.h"
@@ -12,19 +14,20 @@
 namespace pommade {
 
 struct pom_xml_node : public xml_graph::basic_xml_node<pom_xml_node> {
-  static const std::function<pom_xml_node(const xml_graph::xml_node&, bool)> copy_node_fn;
-  
+  static pom_xml_node copy_node(const xml_graph::xml_node& node, bool gap_before) { return pom_xml_node{node, gap_before}; }
+
   const bool gap_before;
 
-  pom_xml_node(unsigned short lineno, unsigned short level, const std::string& name, const std::string* comment, const std::string* content, bool gap_before) : xml_graph::basic_xml_node<pom_xml_node>{lineno, level, name, comment, content}, gap_before{gap_before} {}
+  pom_xml_node(xml_graph::xml_arena& arena, unsigned int lineno, unsigned int level, xml_graph::xml_name name, xml_graph::xml_text comment, xml_graph::xml_text content, bool gap_before) : xml_graph::basic_xml_node<pom_xml_node>{arena, lineno, level, name, comment, content}, gap_before{gap_before} {}
+  // copies node and everything below it, or just its bytes in the document, if it has them
   pom_xml_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node(const pom_xml_node& that) : xml_graph::basic_xml_node<pom_xml_node>{that}, gap_before{that.gap_before} {}
+  pom_xml_node(const pom_xml_node& that, xml_graph::xml_shallow_copy) : xml_graph::basic_xml_node<pom_xml_node>{that, xml_graph::xml_shallow_copy{}}, gap_before{that.gap_before} {}
+  pom_xml_node(pom_xml_node&& that) : xml_graph::basic_xml_node<pom_xml_node>{std::move(that)}, gap_before{that.gap_before} {}
 
-  friend std::ostream& operator<<(std::ostream& os, const pom_xml_node& node) {
-    if (node.gap_before)
-      os << std::endl;
-    os << static_cast<const xml_graph::basic_xml_node<pom_xml_node>&>(node);
-    return os;
+  void write_gap(xml_graph::xml_writer& writer) const {
+    if (gap_before)
+      writer.newline();
   }
 };
 
@@ -35,31 +38,100 @@ struct pom_artifact {
   pom_artifact() {}
   pom_artifact(const std::string& group_id, const std::string& artifact_id) : group_id{group_id}, artifact_id{artifact_id} {}
 
+  bool operator==(const pom_artifact& that) const { return group_id == that.group_id && artifact_id == that.artifact_id; }
   bool operator<(const pom_artifact& that) const;
 };
 
+// groupId[:artifactId], where a groupId ending in '*' matches any groupId it prefixes, and a '*' anywhere in an artifactId matches
+// any run of characters; no (or an empty) artifactId matches any
 struct pom_artifact_matcher : public pom_artifact {
   static pom_artifact_matcher parse(const std::string& pom_artifact_matcher_spec);
 
   bool match(const pom_artifact& that) const;
+  bool match(const xml_graph::xml_text& that_group_id, const xml_graph::xml_text& that_artifact_id) const;
 
 private:  
   pom_artifact_matcher(const std::string& group_id, const std::string& artifact_id = "") : pom_artifact{group_id, artifact_id} {}
 };
 
+// a list of pom_artifact_matchers compiled for finding the first that matches an artifact in one lookup, however many there are:
+// exact groupIds are hashed, and prefix groupIds are in a trie walked along the artifact's groupId; each leads to the artifactIds
+// listed with it, exact ones hashed too; it keeps views of the matchers' text, so they must outlive it
+class pom_artifact_ranker {
+  struct text_hash {
+    std::size_t operator()(const xml_graph::xml_text& text) const;
+  };
+  using rank_map = std::unordered_map<xml_graph::xml_text, std::size_t, text_hash>;
+
+  // the matchers of one groupId (or groupId prefix)
+  struct group_matchers {
+    // of the first matching any artifactId, or none_rank
+    std::size_t any_rank;
+    rank_map artifact_ranks;
+    std::vector<std::pair<xml_graph::xml_text, std::size_t>> artifact_patterns;
+
+    explicit group_matchers(std::size_t any_rank) : any_rank{any_rank} {}
+    std::size_t rank(const xml_graph::xml_text& artifact_id) const;
+  };
+
+  struct trie_node {
+    // sorted by character
+    std::vector<std::pair<char, unsigned int>> children;
+    // into groups, for the groupId prefix ending here; -1 if none does
+    int group;
+
+    trie_node() : group{-1} {}
+  };
+
+  std::size_t none_rank;
+  std::vector<group_matchers> groups;
+  std::unordered_map<xml_graph::xml_text, unsigned int, text_hash> exact_groups;
+  std::vector<trie_node> prefix_trie;
+
+  void add(const pom_artifact_matcher& matcher, std::size_t rank);
+
+ public:
+  explicit pom_artifact_ranker(const std::vector<pom_artifact_matcher>& matchers);
+
+  // the index of the first matcher matching the artifact, or the number of matchers if none does
+  std::size_t rank(const xml_graph::xml_text& group_id, const xml_graph::xml_text& artifact_id) const;
+};
+
+// what dependencies and exclusions sort by: the index of the first preferred artifact matching (or the number of them if none
+// does), then groupId and artifactId as views into the node's text
+struct pom_artifact_key {
+  std::size_t rank;
+  xml_graph::xml_text group_id;
+  xml_graph::xml_text artifact_id;
+
+  bool operator<(const pom_artifact_key& that) const;
+};
+
 class pom_rewriter : private pom_rewriter_fns {
   friend struct pom_rewriter_fns;
-  
+  friend class pom_stream_rewriter;
+  using node_type = pom_xml_node;
+  using sort_key_type = pom_artifact_key;
+
+  // the sections of a project and of its build, in the order they're written in
+  using project_classifier = xml_graph::xml_subnode_classifier<xml_graph::xml_names::model_version, xml_graph::xml_names::parent, xml_graph::xml_names::group_id, xml_graph::xml_names::artifact_id, xml_graph::xml_names::version, xml_graph::xml_names::packaging, xml_graph::xml_names::properties, xml_graph::xml_names::scm, xml_graph::xml_names::distribution_management, xml_graph::xml_names::dependency_management, xml_graph::xml_names::dependencies, xml_graph::xml_names::build, xml_graph::xml_names::modules, xml_graph::xml_names::profiles, xml_graph::xml_names::active_profiles>;
+  enum project_slots { project_model_version = 0, project_parent, project_group_id, project_artifact_id, project_version, project_packaging, project_properties, project_scm, project_distribution_management, project_dependency_management, project_dependencies, project_build, project_modules, project_profiles, project_active_profiles, project_slot_cnt };
+  using build_classifier = xml_graph::xml_subnode_classifier<xml_graph::xml_names::plugin_management, xml_graph::xml_names::plugins, xml_graph::xml_names::resources>;
+  enum build_slots { build_plugin_management = 0, build_plugins, build_resources, build_slot_cnt };
+
   bool has_parent;
-  const std::vector<pom_artifact_matcher>& preferred_artifacts;
+  // the module paths of the POM being rewritten, as listed
+  std::vector<std::string> modules;
+  const pom_artifact_ranker preferred_artifacts;
   
-  const std::function<pom_xml_node(const xml_graph::xml_node&, bool)>& get_rw_fn(rw_key key) { return pom_rewriter_fns::get_rw_fn(key, this); }
-  const std::function<pom_xml_node(const xml_graph::xml_node&, bool)>& get_rw_with_flag_fn(rw_with_flag_key key) { return pom_rewriter_fns::get_rw_with_flag_fn(key, this); }
-  const std::function<bool(const xml_graph::xml_node*, const xml_graph::xml_node*)>& get_lt_fn(lt_key key) { return pom_rewriter_fns::get_lt_fn(key, this); }
+  template <rw_keys key> rw_fn<pom_rewriter, key> get_rw_fn() { return rw_fn<pom_rewriter, key>{this}; }
+  template <rw_with_flags key, bool flag> rw_with_flag_fn<pom_rewriter, key, flag> get_rw_with_flag_fn() { return rw_with_flag_fn<pom_rewriter, key, flag>{this}; }
+  template <sort_keys key> sort_key_fn<pom_rewriter, key> get_sort_key_fn() const { return sort_key_fn<pom_rewriter, key>{this}; }
 
-  static bool add_nonempty_rewrite_node(pom_xml_node& node, bool gap_before, const xml_graph::xml_node* subnode, const std::function<pom_xml_node(const xml_graph::xml_node&, bool)>& rw_fn);
-  static pom_xml_node rewrite_subnodes(const xml_graph::xml_node& node, bool gap_before, bool gap_before_subnodes, const std::function<pom_xml_node(const xml_graph::xml_node&, bool)>& rw_fn);
-  static pom_xml_node rewrite_sort_subnodes(const xml_graph::xml_node& node, bool gap_before, bool gap_before_subnodes, const std::function<pom_xml_node(const xml_graph::xml_node&, bool)>& rw_fn, const std::function<bool(const xml_graph::xml_node*, const xml_graph::xml_node*)>& lt_fn);
+  template <typename RwFn> static bool add_nonempty_rewrite_node(pom_xml_node& node, bool gap_before, const xml_graph::xml_node* subnode, const RwFn& rw_fn);
+  template <typename RwFn> static pom_xml_node rewrite_subnodes(const xml_graph::xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn);
+  template <typename RwFn, typename LtFn> static pom_xml_node rewrite_sort_subnodes(const xml_graph::xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn, const LtFn& lt_fn);
+  template <typename RwFn, typename KeyFn> static pom_xml_node rewrite_key_sort_subnodes(const xml_graph::xml_node& node, bool gap_before, bool gap_before_subnodes, const RwFn& rw_fn, const KeyFn& key_fn);
 
   static pom_xml_node rewrite_leaf_node(const xml_graph::xml_node& node, bool gap_before);
   static pom_xml_node rewrite_leaf_subnodes(const xml_graph::xml_node& node, bool gap_before);
@@ -72,6 +144,7 @@ class pom_rewriter : private pom_rewriter_fns {
   pom_xml_node rewrite_dependency_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_dependencies_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_dependency_management_node(const xml_graph::xml_node& node, bool gap_before);
+  pom_xml_node rewrite_module_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_modules_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_property_node(const xml_graph::xml_node& node, bool gap_before, bool unvalued_ok = false);
   pom_xml_node rewrite_properties_node(const xml_graph::xml_node& node, bool gap_before);
@@ -92,16 +165,36 @@ class pom_rewriter : private pom_rewriter_fns {
   pom_xml_node rewrite_profile_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_profiles_node(const xml_graph::xml_node& node, bool gap_before);
   pom_xml_node rewrite_active_profiles_node(const xml_graph::xml_node& node, bool gap_before);
+  void start_project() {
+    has_parent = false;
+    modules.clear();
+  }
   pom_xml_node rewrite_project_node(const xml_graph::xml_node& node);
+  // a project or build listing one of its sections twice can't be rewritten (neither whole nor streamed): which to keep is anyone's
+  // guess
+  [[noreturn]] static void fail_duplicate_section(const xml_graph::xml_name& name, const xml_graph::xml_name& owner_name, unsigned int lineno);
+  // rewrite the section in slot (if there is one) as rewrite_build_node and rewrite_project_node would, adding it to the rewritten
+  // build or project; false if nothing was added
+  bool add_build_section(pom_xml_node& rw_build, std::size_t slot, const xml_graph::xml_node* node);
+  bool add_project_section(pom_xml_node& rw_project, std::size_t slot, const xml_graph::xml_node* node);
 
-  static pom_artifact build_pom_artifact(const xml_graph::xml_node& node);
+  pom_artifact_key build_pom_artifact_key(const xml_graph::xml_node& node) const;
 
-  bool lt_artifact_nodes(const xml_graph::xml_node* a, const xml_graph::xml_node* b) const;
+  // indexed by rw_keys, rw_with_flags and sort_keys respectively
+  static constexpr pom_xml_node (pom_rewriter::*const rw_fns[rw_key_cnt])(const xml_graph::xml_node&, bool){&pom_rewriter::rewrite_parent_node, &pom_rewriter::rewrite_distribution_management_node, &pom_rewriter::rewrite_exclusion_node, &pom_rewriter::rewrite_exclusions_node, &pom_rewriter::rewrite_dependency_node, &pom_rewriter::rewrite_dependencies_node, &pom_rewriter::rewrite_dependency_management_node, &pom_rewriter::rewrite_properties_node, &pom_rewriter::rewrite_activation_node, &pom_rewriter::rewrite_configuration_node, &pom_rewriter::rewrite_execution_node, &pom_rewriter::rewrite_executions_node, &pom_rewriter::rewrite_plugin_node, &pom_rewriter::rewrite_plugins_node, &pom_rewriter::rewrite_plugin_management_node, &pom_rewriter::rewrite_resource_node, &pom_rewriter::rewrite_resources_node, &pom_rewriter::rewrite_build_node, &pom_rewriter::rewrite_profile_node, &pom_rewriter::rewrite_profiles_node, &pom_rewriter::rewrite_active_profiles_node, &pom_rewriter::rewrite_module_node, &pom_rewriter::rewrite_modules_node};
+  static constexpr pom_xml_node (pom_rewriter::*const rw_with_flag_fns[rw_with_flag_key_cnt])(const xml_graph::xml_node&, bool, bool){&pom_rewriter::rewrite_property_node};
+  static constexpr pom_artifact_key (pom_rewriter::*const sort_key_fns[sort_key_cnt])(const xml_graph::xml_node&) const {&pom_rewriter::build_pom_artifact_key};
 
  public:
+  // bump whenever a change makes some POM rewrite differently: cached results are only valid for the version they were made by
+  static const unsigned int output_version = 3;
+
   pom_rewriter(const std::vector<pom_artifact_matcher>& preferred_artifacts) : has_parent{}, preferred_artifacts{preferred_artifacts} {}
 
+  // the rewritten tree shares the source document's arena (and text), so it must not outlive that document
   pom_xml_node rewrite_pom(const xml_graph::xml_node* node);
+  // the modules listed by the POM last rewritten (whole or streamed), in their order
+  const std::vector<std::string>& get_modules() const { return modules; }
 };
 }
 #endif
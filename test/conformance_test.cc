@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "pom_batch.h"
+#include "rewrite_pom.h"
+#include "xml_doc_buffer.h"
+#include "xml_graph.h"
+#include "xml_parser.h"
+#include "xml_scanner.h"
+
+namespace {
+using namespace std;
+using namespace pommade;
+using namespace xml_graph;
+using namespace xml_parser;
+
+// the .xml files in each directory given (in name order) and each file given
+vector<string>
+corpus_files(int argc, const char* argv[]) {
+  vector<string> files;
+  for (int i{1}; i < argc; ++i) {
+    if (!boost::filesystem::is_directory(argv[i])) {
+      files.push_back(argv[i]);
+      continue;
+    }
+    vector<string> dir_files;
+    for (boost::filesystem::directory_iterator it{argv[i]}, end; it != end; ++it) {
+      if (it->path().extension() == ".xml")
+        dir_files.push_back(it->path().string());
+    }
+    sort(dir_files.begin(), dir_files.end());
+    files.insert(files.end(), dir_files.cbegin(), dir_files.cend());
+  }
+  return files;
+}
+
+// a file's rewrite, and everything said about it on the way
+struct rewrite_result {
+  bool ok;
+  string out;
+  string err;
+};
+
+rewrite_result
+rewrite(pom_batch_rewriter& batch_rewriter, const string& file) {
+  ostringstream out_oss;
+  ostringstream err_oss;
+  const bool ok{batch_rewriter.rewrite_file(file, out_oss, err_oss)};
+  return rewrite_result{ok, out_oss.str(), err_oss.str()};
+}
+
+// where two strings first differ, as "line:column"
+string
+first_difference(const string& s, const string& that) {
+  const size_t offset{static_cast<size_t>(mismatch(s.cbegin(), s.cbegin() + static_cast<ptrdiff_t>(min(s.size(), that.size())), that.cbegin()).first - s.cbegin())};
+  const size_t line_end{offset ? s.rfind('\n', offset - 1) : string::npos};
+  const size_t column{line_end == string::npos ? offset + 1 : offset - line_end};
+  return to_string(1 + count(s.cbegin(), s.cbegin() + static_cast<ptrdiff_t>(offset), '\n')) + ':' + to_string(column);
+}
+
+// why the file isn't rewritten the same natively as by Xerces, or "" if it is
+string
+check_rewrite(pom_batch_rewriter& native_rewriter, pom_batch_rewriter& xerces_rewriter, const string& file) {
+  const rewrite_result native{rewrite(native_rewriter, file)};
+  const rewrite_result xerces{rewrite(xerces_rewriter, file)};
+  if (!xerces.ok)
+    return "Xerces can't rewrite it: " + xerces.err;
+  if (native.ok != xerces.ok)
+    return "only Xerces rewrites it: " + native.err;
+  if (native.out != xerces.out)
+    return "native and Xerces rewrites differ at " + first_difference(native.out, xerces.out);
+  if (native.err != xerces.err)
+    return "native and Xerces diagnostics differ:\n" + native.err + "rather than:\n" + xerces.err;
+  return string{};
+}
+
+bool
+same_text(const xml_text& text, const xml_text& that_text) {
+  return static_cast<bool>(text) == static_cast<bool>(that_text) && text == that_text;
+}
+
+// the first node (in document order) where two documents differ, source included, or nullptr if they're identical
+const xml_node*
+first_difference(const xml_node* root, const xml_node* that_root) {
+  const unsigned int node_cnt{min(root->get_span(), that_root->get_span())};
+  for (unsigned int i{}; i < node_cnt; ++i) {
+    const xml_node& node = root[i];
+    const xml_node& that_node = that_root[i];
+    if (node.get_span() != that_node.get_span() || node.tree().node_cnt() != that_node.tree().node_cnt() || node.lineno != that_node.lineno || node.level != that_node.level || node.name != that_node.name || !same_text(node.comment, that_node.comment) || !same_text(node.get_content(), that_node.get_content()) || !same_text(node.get_source(), that_node.get_source()))
+      return &node;
+  }
+  return root->get_span() == that_root->get_span() ? nullptr : root + node_cnt;
+}
+
+// a file whose name starts with this is expected to be left to Xerces, any other to be scanned natively
+const char* const fallback_prefix = "fallback-";
+
+// why the file isn't parsed into the same document natively as by Xerces (or left to Xerces as expected), or "" if it is
+string
+check_parse(const string& file) {
+  const xml_doc_buffer buffer{xml_doc_buffer::map_file(file.c_str())};
+  default_xml_doc_handler doc_handler;
+  xml_scanner scanner;
+  ostringstream diagnostics;
+  const xml_diagnostics_redirect diagnostics_redirect{diagnostics};
+  const bool native{scanner.scan(buffer.data(), buffer.size(), doc_handler)};
+  if (native == !boost::filesystem::path{file}.filename().string().compare(0, strlen(fallback_prefix), fallback_prefix))
+    return native ? "scanned natively rather than left to Xerces" : "left to Xerces rather than scanned natively";
+  if (!native)
+    return string{};
+  const xml_doc<xml_node> native_doc{static_cast<xml_doc_handler&>(doc_handler).doc()};
+  xml_doc_parser doc_parser{doc_handler, xml_parser_backend::xerces};
+  const xml_doc<xml_node> xerces_doc{doc_parser.parse_doc(buffer.data(), buffer.size(), file.c_str())};
+  const xml_node* const node = first_difference(native_doc.get(), xerces_doc.get());
+  return node ? "native and Xerces documents differ at '" + node->name.str() + "'; line " + to_string(node->lineno) : string{};
+}
+}
+
+// parses every POM of the corpus with the native parser and with Xerces alone, failing unless each is parsed into the same
+// document both ways (or, as its name says, left to Xerces) and then rewritten byte for byte the same both ways, with the same
+// diagnostics
+int
+main(int argc, const char* argv[]) {
+  if (argc < 2) {
+    cerr << "usage: conformance_test dir|file..." << endl;
+    return 2;
+  }
+  const xml_platform platform;
+  pom_batch_options native_options;
+  native_options.parser_backend = xml_parser_backend::native;
+  pom_batch_options xerces_options;
+  xerces_options.parser_backend = xml_parser_backend::xerces;
+  pom_batch_rewriter native_rewriter{vector<pom_artifact_matcher>{}, native_options};
+  pom_batch_rewriter xerces_rewriter{vector<pom_artifact_matcher>{}, xerces_options};
+
+  size_t failed_cnt{};
+  const vector<string> files{corpus_files(argc, argv)};
+  for (const auto& file : files) {
+    try {
+      string failure{check_parse(file)};
+      if (failure.empty())
+        failure = check_rewrite(native_rewriter, xerces_rewriter, file);
+      if (failure.empty())
+        cout << file << ": ok" << endl;
+      else {
+        cout << file << ": " << failure << endl;
+        ++failed_cnt;
+      }
+    } catch (const exception& e) {
+      cout << file << ": " << e.what() << endl;
+      ++failed_cnt;
+    }
+  }
+  cout << files.size() - failed_cnt << " of " << files.size() << " POMs parsed and rewritten the same natively and by Xerces" << endl;
+  return failed_cnt || files.empty() ? 1 : 0;
+}
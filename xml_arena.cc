@@ -0,0 +1,24 @@
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+#include "xml_arena.h"
+
+namespace xml_graph {
+using namespace std;
+
+const size_t xml_arena::min_block_size;
+const size_t xml_arena::max_block_size;
+
+void*
+xml_arena::allocate_block(size_t size, size_t align) {
+  // blocks double in size up to a limit; oversized requests get a block of their own
+  const size_t new_block_size{max(block_size, size + align)};
+  blocks.emplace_back(new char[new_block_size]);
+  allocated += new_block_size;
+  next = blocks.back().get();
+  end = next + new_block_size;
+  block_size = min(block_size * 2, max_block_size);
+  return allocate(size, align);
+}
+}
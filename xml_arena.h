@@ -0,0 +1,99 @@
+#ifndef XML_ARENA_H
+#define XML_ARENA_H
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xml_graph {
+
+// immutable characters owned by an xml_arena (or by whatever else outlives the text); a default xml_text is absent, not empty
+class xml_text {
+  const char* chars;
+  std::size_t len;
+
+ public:
+  xml_text() : chars{}, len{} {}
+  xml_text(const char* chars, std::size_t len) : chars{chars}, len{len} {}
+
+  explicit operator bool() const { return chars; }
+  const char* data() const { return chars; }
+  std::size_t size() const { return len; }
+  std::string str() const { return std::string{chars, len}; }
+
+  int compare(const xml_text& that) const {
+    const std::size_t cmp_len{len < that.len ? len : that.len};
+    const int cmp{cmp_len ? std::memcmp(chars, that.chars, cmp_len) : 0};
+    return cmp ? cmp : (len < that.len ? -1 : len > that.len);
+  }
+  bool operator==(const xml_text& that) const { return len == that.len && (!len || !std::memcmp(chars, that.chars, len)); }
+  bool operator!=(const xml_text& that) const { return !(*this == that); }
+  bool operator<(const xml_text& that) const { return compare(that) < 0; }
+
+  friend std::ostream& operator<<(std::ostream& os, const xml_text& text) { return os.write(text.chars, static_cast<std::streamsize>(text.len)); }
+};
+
+// bump allocator holding everything of one document; nothing is freed (or destroyed) until the arena itself goes
+class xml_arena {
+  static const std::size_t min_block_size = 64 * 1024;
+  static const std::size_t max_block_size = 1024 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char* next;
+  char* end;
+  std::size_t block_size;
+  std::size_t allocated;
+
+  void* allocate_block(std::size_t size, std::size_t align);
+
+ public:
+  xml_arena() : next{}, end{}, block_size{min_block_size}, allocated{} {}
+  xml_arena(const xml_arena&) = delete;
+  xml_arena& operator=(const xml_arena&) = delete;
+
+  void* allocate(std::size_t size, std::size_t align) {
+    char* const p = reinterpret_cast<char*>((reinterpret_cast<std::size_t>(next) + align - 1) & ~(align - 1));
+    if (next && p + size <= end) {
+      next = p + size;
+      return p;
+    }
+    return allocate_block(size, align);
+  }
+
+  // only for types whose destructors may be skipped, i.e. that own nothing but arena memory
+  template <typename T, typename... Args> T* make(Args&&... args) { return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+
+  xml_text copy(const char* chars, std::size_t len) {
+    char* const cp = static_cast<char*>(allocate(len ? len : 1, 1));
+    std::memcpy(cp, chars, len);
+    return xml_text{cp, len};
+  }
+  xml_text copy(const std::string& s) { return copy(s.data(), s.size()); }
+
+  std::size_t block_cnt() const { return blocks.size(); }
+  // the bytes of all blocks, used or not
+  std::size_t allocated_size() const { return allocated; }
+};
+
+// lets standard containers allocate from an xml_arena; deallocation is a no-op
+template <typename T> struct xml_arena_allocator {
+  using value_type = T;
+
+  xml_arena* arena;
+
+  xml_arena_allocator(xml_arena& arena) : arena{&arena} {}
+  template <typename U> xml_arena_allocator(const xml_arena_allocator<U>& that) : arena{that.arena} {}
+
+  T* allocate(std::size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T*, std::size_t) {}
+
+  template <typename U> bool operator==(const xml_arena_allocator<U>& that) const { return arena == that.arena; }
+  template <typename U> bool operator!=(const xml_arena_allocator<U>& that) const { return arena != that.arena; }
+};
+}
+#endif
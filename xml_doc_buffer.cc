@@ -0,0 +1,67 @@
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "xml_doc_buffer.h"
+
+namespace xml_parser {
+using namespace std;
+using namespace boost::interprocess;
+
+xml_doc_buffer::xml_doc_buffer() {}
+
+xml_doc_buffer::~xml_doc_buffer() {}
+
+xml_doc_buffer::xml_doc_buffer(xml_doc_buffer&& that) : mapping{move(that.mapping)}, region{move(that.region)}, bytes{move(that.bytes)} {}
+
+xml_doc_buffer
+xml_doc_buffer::map_file(const char* file) {
+  xml_doc_buffer buffer{};
+  try {
+    // empty files can't be mapped
+    if (boost::filesystem::file_size(file)) {
+      buffer.mapping.reset(new file_mapping{file, read_only});
+      buffer.region.reset(new mapped_region{*buffer.mapping, read_only});
+      buffer.region->advise(mapped_region::advice_sequential);
+    }
+  } catch (const exception& e) {
+    throw runtime_error{string{"can't map '"} + file + "': " + e.what()};
+  }
+  return buffer;
+}
+
+xml_doc_buffer
+xml_doc_buffer::read(istream& is) {
+  xml_doc_buffer buffer{};
+  buffer.bytes.assign(istreambuf_iterator<char>{is}, istreambuf_iterator<char>{});
+  return buffer;
+}
+
+xml_doc_buffer
+xml_doc_buffer::read_file(const char* file) {
+  ifstream is{file, ios::binary};
+  if (!is)
+    throw runtime_error{string{"can't read '"} + file + '\''};
+  return read(is);
+}
+
+const char*
+xml_doc_buffer::data() const {
+  return region ? static_cast<const char*>(region->get_address()) : bytes.data();
+}
+
+size_t
+xml_doc_buffer::size() const {
+  return region ? region->get_size() : bytes.size();
+}
+}
@@ -0,0 +1,39 @@
+#ifndef XML_DOC_BUFFER_H
+#define XML_DOC_BUFFER_H
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <string>
+
+namespace boost {
+namespace interprocess {
+class file_mapping;
+class mapped_region;
+}
+}
+
+namespace xml_parser {
+
+// a document's bytes, either mapped read-only from a file or read into memory (e.g. from stdin)
+class xml_doc_buffer {
+  std::unique_ptr<boost::interprocess::file_mapping> mapping;
+  std::unique_ptr<boost::interprocess::mapped_region> region;
+  std::string bytes;
+
+  xml_doc_buffer();
+
+ public:
+  ~xml_doc_buffer();
+  xml_doc_buffer(xml_doc_buffer&& that);
+
+  static xml_doc_buffer map_file(const char* file);
+  static xml_doc_buffer read(std::istream& is);
+  // for a file that may be truncated while it's parsed, which a mapping of it wouldn't survive
+  static xml_doc_buffer read_file(const char* file);
+
+  const char* data() const;
+  std::size_t size() const;
+};
+}
+#endif
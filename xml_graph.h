@@ -1,97 +1,163 @@
 #ifndef XML_GRAPH_H
 #define XML_GRAPH_H
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
 #include <iterator>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
+#include "xml_arena.h"
+#include "xml_name.h"
+#include "xml_writer.h"
+
 namespace xml_graph {
 
 template <typename Node> class xml_tree;
+template <typename Node> class xml_tree_iterator;
+template <typename Node> xml_writer& operator<<(xml_writer& writer, const xml_tree<Node>& tree);
 template <typename Node> std::ostream& operator<<(std::ostream& os, const xml_tree<Node>& tree);
 
+// selects a node's constructor that copies all of it but its subtree, which xml_tree's copy constructor then copies itself
+struct xml_shallow_copy {};
+
+// nodes, their subtrees and their text all live in one xml_arena; a Node may hide write_gap() to write something before itself
 template <typename Node> class basic_xml_node {
+  friend class xml_tree<Node>;
+
+  xml_arena* const arena;
+
  public:
-  const unsigned short lineno;
-  const unsigned short level;
-  const std::string name;
-  const std::unique_ptr<const std::string> comment;
+  const unsigned int lineno;
+  const unsigned int level;
+  const xml_name name;
+  const xml_text comment;
 
  private:
-  std::unique_ptr<std::string> content;
-  std::unique_ptr<xml_tree<Node>> subtree;
+  xml_text content;
+  xml_tree<Node>* subtree;
+  // the node as it is in the document it was parsed from, if it's to be written so rather than from its content and subtree
+  xml_text source;
 
  public:
-  basic_xml_node(unsigned short lineno, unsigned short level, const std::string& name, const std::string* comment = nullptr, const std::string* content = nullptr) : lineno{lineno}, level{level}, name{name}, comment{comment ? new std::string{*comment} : nullptr}, content{content ? new std::string{*content} : nullptr} {}
-  basic_xml_node(const basic_xml_node& that) : lineno{that.lineno}, level{that.level}, name{that.name}, comment{that.comment ? new std::string{*that.comment} : nullptr}, content{that.content ? new std::string{*that.content} : nullptr}, subtree{that.subtree ? new xml_tree<Node>{*that.subtree} : nullptr} {}
+  basic_xml_node(xml_arena& arena, unsigned int lineno, unsigned int level, xml_name name, xml_text comment = xml_text{}, xml_text content = xml_text{}) : arena{&arena}, lineno{lineno}, level{level}, name{name}, comment{comment}, content{content}, subtree{}, source{} {}
+  basic_xml_node(const basic_xml_node& that) : arena{that.arena}, lineno{that.lineno}, level{that.level}, name{that.name}, comment{that.comment}, content{that.content}, subtree{that.subtree ? arena->make<xml_tree<Node>>(*that.subtree) : nullptr}, source{that.source} {}
+  basic_xml_node(const basic_xml_node& that, xml_shallow_copy) : arena{that.arena}, lineno{that.lineno}, level{that.level}, name{that.name}, comment{that.comment}, content{that.content}, subtree{}, source{that.source} {}
+  // splices that's subtree in without copying it: both nodes live in the same arena
+  basic_xml_node(basic_xml_node&& that) : arena{that.arena}, lineno{that.lineno}, level{that.level}, name{that.name}, comment{that.comment}, content{that.content}, subtree{that.subtree}, source{that.source} { that.subtree = nullptr; }
 
   bool operator==(const basic_xml_node& that) const { return level == that.level && name == that.name; }
   bool operator<(const basic_xml_node& that) const { return level < that.level || (level == that.level && name < that.name); }
 
-  const std::string* get_content() const { return content.get(); }
-  void set_content(const std::string& s) { content.reset(new std::string{s}); }
-  void append_content(const std::string& s) { content.get()->append(s); }
+  xml_arena& get_arena() const { return *arena; }
+
+  const xml_text& get_content() const { return content; }
+  void set_content(const char* chars, std::size_t len) { content = arena->copy(chars, len); }
+  void append_content(const char* chars, std::size_t len);
 
   Node* add_subnode(Node&& subnode);
-  void add_subnodes(std::vector<std::unique_ptr<const Node>>&& subnodes);
-  const xml_tree<Node>* tree() const { return subtree && subtree.get()->node_cnt() ? subtree.get() : nullptr; }
+  const xml_tree<Node>* tree() const { return subtree && subtree->node_cnt() ? subtree : nullptr; }
+
+  const xml_text& get_source() const { return source; }
+  void set_source(const char* chars, std::size_t len) { source = xml_text{chars, len}; }
 
+  void write_gap(xml_writer& writer) const {}
+  // writes node and everything below it, depth first but without recursing, so that no nesting is too deep for the stack
+  static void write(xml_writer& writer, const Node& node);
+
+  friend xml_writer& operator<<(xml_writer& writer, const basic_xml_node& node) {
+    write(writer, static_cast<const Node&>(node));
+    return writer;
+  }
   friend std::ostream& operator<<(std::ostream& os, const basic_xml_node& node) {
-    if (node.comment) {
-      for (auto i = 0U; i < node.level; ++i)
-        os << '\t';
-      os << "<!--" << *node.comment << "-->" << std::endl;
-    }
-    for (auto i = 0U; i < node.level; ++i)
-      os << '\t';
-    os << '<' << node.name << '>';
-    if (node.subtree) {
-      os << std::endl << *node.subtree;
-      for (auto i = 0U; i < node.level; ++i)
-        os << '\t';
-    } else if (node.content)
-      os << *node.content;
-    os << "</" << node.name << '>' << std::endl;
-    return os;
+    xml_writer writer;
+    writer << static_cast<const Node&>(node);
+    return os << writer;
   }
 };
 
 template <typename Node>
-Node*
-basic_xml_node<Node>::add_subnode(Node&& subnode) {
-  if (!subtree)
-    subtree.reset(new xml_tree<Node>{});
-  return subtree->add_node(std::move(subnode));
+void
+basic_xml_node<Node>::append_content(const char* chars, std::size_t len) {
+  // content split across callbacks (e.g. around entity references) is rare enough to just re-copy
+  std::string joined{content.str()};
+  joined.append(chars, len);
+  content = arena->copy(joined);
 }
 
 template <typename Node>
 void
-basic_xml_node<Node>::add_subnodes(std::vector<std::unique_ptr<const Node>>&& subnodes) {
+basic_xml_node<Node>::write(xml_writer& writer, const Node& node) {
+  // the nodes whose subtrees are being written, each with its next subnode to write
+  std::vector<std::pair<const Node*, xml_tree_iterator<Node>>> open_nodes;
+  for (const Node* nodep{&node}; nodep;) {
+    nodep->write_gap(writer);
+    if (nodep->comment) {
+      writer.indent(nodep->level);
+      writer << "<!--" << nodep->comment << "-->";
+      writer.newline();
+    }
+    writer.indent(nodep->level);
+    if (nodep->source) {
+      writer.verbatim(nodep->source);
+      writer.newline();
+    } else if (nodep->subtree) {
+      writer << '<' << nodep->name << '>';
+      writer.newline();
+      open_nodes.emplace_back(nodep, nodep->subtree->cbegin());
+    } else {
+      writer << '<' << nodep->name << '>';
+      if (nodep->content)
+        writer << nodep->content;
+      writer << "</" << nodep->name << '>';
+      writer.newline();
+    }
+
+    // on to the next subnode of the innermost open node that has one left, closing those that don't
+    nodep = nullptr;
+    while (!open_nodes.empty() && !nodep) {
+      auto& open_node = open_nodes.back();
+      if (open_node.second != open_node.first->subtree->cend() && writer) {
+        nodep = &*open_node.second;
+        ++open_node.second;
+      } else {
+        writer.indent(open_node.first->level);
+        writer << "</" << open_node.first->name << '>';
+        writer.newline();
+        open_nodes.pop_back();
+      }
+    }
+  }
+}
+
+template <typename Node>
+Node*
+basic_xml_node<Node>::add_subnode(Node&& subnode) {
+  assert(&subnode.get_arena() == arena);
   if (!subtree)
-    subtree.reset(new xml_tree<Node>{});
-  return subtree->add_nodes(std::move(subnodes));
+    subtree = arena->make<xml_tree<Node>>(*arena);
+  return subtree->add_node(std::move(subnode));
 }
 
-// TODO: is this necessary?
-struct xml_node : public basic_xml_node<xml_node> {
-  xml_node(const xml_node& that) : basic_xml_node{that} {}
-  xml_node(unsigned short lineno, unsigned short level, const std::string& name, const std::string* comment = nullptr, const std::string* content = nullptr) : basic_xml_node{lineno, level, name, comment, content} {}
-};
+template <typename Node> using xml_node_ptrs = std::vector<const Node*, xml_arena_allocator<const Node*>>;
 
 template <typename Node> class xml_tree_iterator {
-  typename std::vector<std::unique_ptr<const Node>>::const_iterator nodes_it;
+  typename xml_node_ptrs<Node>::const_iterator nodes_it;
 
  public:
-  xml_tree_iterator(typename std::vector<std::unique_ptr<const Node>>::const_iterator nodes_it) : nodes_it{nodes_it} {}
+  xml_tree_iterator(typename xml_node_ptrs<Node>::const_iterator nodes_it) : nodes_it{nodes_it} {}
 
   xml_tree_iterator operator++();
   bool operator==(const xml_tree_iterator& that) const { return that.nodes_it == nodes_it; }
   bool operator!=(const xml_tree_iterator& that) const { return that.nodes_it != nodes_it; }
   const Node& operator*() const { return **nodes_it; }
-  const Node* operator->() const { return nodes_it->get(); }
+  const Node* operator->() const { return *nodes_it; }
 };
 
 template <typename Node> xml_tree_iterator<Node> xml_tree_iterator<Node>::operator++() {
@@ -100,49 +166,62 @@ template <typename Node> xml_tree_iterator<Node> xml_tree_iterator<Node>::operat
 }
 
 template <typename Node> class xml_tree {
-  typename std::vector<std::unique_ptr<const Node>> nodes;
+  xml_node_ptrs<Node> nodes;
 
  public:
-  xml_tree() {}
+  xml_tree(xml_arena& arena) : nodes{xml_arena_allocator<const Node*>{arena}} {}
   xml_tree(const xml_tree& that);
+  xml_tree(xml_tree&& that) : nodes{std::move(that.nodes)} {}
 
   Node* add_node(Node&& node);
-  void add_nodes(typename std::vector<std::unique_ptr<const Node>>&& nodes);
 
   unsigned int node_cnt() const { return static_cast<unsigned int>(nodes.size()); }
   xml_tree_iterator<Node> cbegin() const { return xml_tree_iterator<Node>{nodes.cbegin()}; }
   xml_tree_iterator<Node> cend() const { return xml_tree_iterator<Node>{nodes.cend()}; }
 
-  std::vector<const Node*> find_in(const std::vector<const char*>& name_in) const;
-  std::vector<const Node*> find_not_in(const std::vector<const char*>& name_not_in) const;
+  std::vector<const Node*> find_in(const std::vector<xml_name>& name_in) const;
+  std::vector<const Node*> find_not_in(const std::vector<xml_name>& name_not_in) const;
 };
 
-template <typename Node> xml_tree<Node>::xml_tree(const xml_tree& that) {
-  for (const auto& node : that.nodes)
-    nodes.push_back(node ? std::unique_ptr<Node>{new Node{*node}} : std::unique_ptr<Node>{});
+// copies each node shallowly, and its subtree in turn off a list of trees still to copy rather than recursively, so that no nesting
+// is too deep for the stack
+template <typename Node> xml_tree<Node>::xml_tree(const xml_tree& that) : nodes{that.nodes.get_allocator()} {
+  xml_arena& arena = *nodes.get_allocator().arena;
+  std::vector<std::pair<xml_tree*, const xml_tree*>> uncopied_trees{{this, &that}};
+  while (!uncopied_trees.empty()) {
+    const auto trees = uncopied_trees.back();
+    uncopied_trees.pop_back();
+    trees.first->nodes.reserve(trees.second->nodes.size());
+    for (const auto nodep : trees.second->nodes) {
+      Node* copyp{};
+      if (nodep) {
+        copyp = arena.template make<Node>(*nodep, xml_shallow_copy{});
+        if (nodep->subtree) {
+          copyp->subtree = arena.template make<xml_tree>(arena);
+          uncopied_trees.emplace_back(copyp->subtree, nodep->subtree);
+        }
+      }
+      trees.first->nodes.push_back(copyp);
+    }
+  }
 }
 
 template <typename Node>
 Node*
 xml_tree<Node>::add_node(Node&& node) {
-  Node* nodep{};
-  nodes.push_back(std::unique_ptr<const Node>{nodep = new Node{std::move(node)}});
+  Node* const nodep = nodes.get_allocator().arena->template make<Node>(std::move(node));
+  nodes.push_back(nodep);
   return nodep;
 }
 
-template <typename Node>
-void
-xml_tree<Node>::add_nodes(std::vector<std::unique_ptr<const Node>>&& nodes) {
-  std::move(nodes.begin(), nodes.end(), std::back_inserter(this->nodes));
-}
-
-template <typename Node>
+// shared by all tree representations
+template <typename Node, typename Tree>
 std::vector<const Node*>
-xml_tree<Node>::find_in(const std::vector<const char*>& name_in) const {
+find_in_tree(const Tree& tree, const std::vector<xml_name>& name_in) {
   std::vector<const Node*> found{};
   for (const auto& name : name_in) {
     bool found_name_in = false;
-    for (auto cit = cbegin(); cit != cend(); ++cit) {
+    for (auto cit = tree.cbegin(); cit != tree.cend(); ++cit) {
       if (cit->name == name) {
         found.push_back(&*cit);
         found_name_in = true;
@@ -154,13 +233,13 @@ xml_tree<Node>::find_in(const std::vector<const char*>& name_in) const {
   return found;
 }
 
-template <typename Node>
+template <typename Node, typename Tree>
 std::vector<const Node*>
-xml_tree<Node>::find_not_in(const std::vector<const char*>& name_not_in) const {
+find_not_in_tree(const Tree& tree, const std::vector<xml_name>& name_not_in) {
   std::vector<const Node*> found{};
   for (const auto& name : name_not_in) {
     bool found_name_not_in = false;
-    for (auto cit = cbegin(); cit != cend(); ++cit) {
+    for (auto cit = tree.cbegin(); cit != tree.cend(); ++cit) {
       if (cit->name != name) {
         found.push_back(&*cit);
         found_name_not_in = true;
@@ -172,10 +251,403 @@ xml_tree<Node>::find_not_in(const std::vector<const char*>& name_not_in) const {
   return found;
 }
 
+// the subnodes found by xml_subnode_classifier: the first subnode of each listed name by slot, plus any duplicates
+template <typename Node, std::size_t N> class xml_subnode_slots {
+  template <xml_names::ids... Ids> friend class xml_subnode_classifier;
+
+  std::array<const Node*, N> firsts;
+  std::vector<std::pair<std::size_t, const Node*>> duplicates;
+  unsigned int unlisted_cnt;
+
+  xml_subnode_slots() : unlisted_cnt{} { firsts.fill(nullptr); }
+
+ public:
+  std::size_t size() const { return N; }
+  const Node* operator[](std::size_t i) const { return firsts[i]; }
+
+  unsigned int duplicate_cnt() const { return static_cast<unsigned int>(duplicates.size()); }
+  // the first subnode found with the name of one before it, if any
+  const Node* first_duplicate() const { return duplicates.empty() ? nullptr : duplicates.front().second; }
+  unsigned int unlisted_subnode_cnt() const { return unlisted_cnt; }
+
+  // every subnode of the slot's name, in document order
+  std::vector<const Node*> all(std::size_t i) const;
+  // the same nodes, in the same order, as find_in would have returned
+  std::vector<const Node*> found() const;
+};
+
+template <typename Node, std::size_t N>
+std::vector<const Node*>
+xml_subnode_slots<Node, N>::all(std::size_t i) const {
+  std::vector<const Node*> all_in_slot{};
+  if (firsts[i]) {
+    all_in_slot.push_back(firsts[i]);
+    for (const auto& duplicate : duplicates) {
+      if (duplicate.first == i)
+        all_in_slot.push_back(duplicate.second);
+    }
+  }
+  return all_in_slot;
+}
+
+template <typename Node, std::size_t N>
+std::vector<const Node*>
+xml_subnode_slots<Node, N>::found() const {
+  std::vector<const Node*> found{};
+  for (auto i = 0U; i < N; ++i) {
+    if (firsts[i]) {
+      const std::vector<const Node*> all_in_slot{all(i)};
+      found.insert(found.end(), all_in_slot.cbegin(), all_in_slot.cend());
+    } else
+      found.push_back(nullptr);
+  }
+  return found;
+}
+
+// classifies a node's subnodes against a fixed list of names in a single pass over them, looking each subnode's slot up by
+// name id rather than comparing it against every listed name
+template <xml_names::ids... Ids> class xml_subnode_classifier {
+  static const std::size_t slot_cnt = sizeof...(Ids);
+
+  struct slot_table {
+    signed char slots[xml_names::known_cnt];
+
+    slot_table() {
+      std::fill(std::begin(slots), std::end(slots), -1);
+      const xml_names::ids ids[]{Ids...};
+      for (auto i = 0U; i < slot_cnt; ++i) {
+        if (slots[ids[i]] < 0)
+          slots[ids[i]] = static_cast<signed char>(i);
+      }
+    }
+  };
+
+  static const slot_table& slots() {
+    static const slot_table table{};
+    return table;
+  }
+
+ public:
+  template <typename Node> static xml_subnode_slots<Node, slot_cnt> classify(const Node& node);
+  // the slot a subnode of this name is classified into, or -1 if the name isn't listed
+  static int slot(const xml_name& name) {
+    const unsigned int id{name.id()};
+    return id < xml_names::known_cnt ? slots().slots[id] : -1;
+  }
+};
+
+template <xml_names::ids... Ids>
+template <typename Node>
+xml_subnode_slots<Node, xml_subnode_classifier<Ids...>::slot_cnt>
+xml_subnode_classifier<Ids...>::classify(const Node& node) {
+  static_assert(slot_cnt < 128, "too many names to classify");
+  xml_subnode_slots<Node, slot_cnt> found{};
+  if (!node.tree())
+    return found;
+  const auto cend = node.tree()->cend();
+  for (auto cit = node.tree()->cbegin(); cit != cend; ++cit) {
+    const int slot{xml_subnode_classifier::slot(cit->name)};
+    if (slot < 0)
+      ++found.unlisted_cnt;
+    else if (!found.firsts[slot])
+      found.firsts[slot] = &*cit;
+    else
+      found.duplicates.emplace_back(slot, &*cit);
+  }
+  return found;
+}
+
+template <typename Node>
+std::vector<const Node*>
+xml_tree<Node>::find_in(const std::vector<xml_name>& name_in) const {
+  return find_in_tree<Node>(*this, name_in);
+}
+
+template <typename Node>
+std::vector<const Node*>
+xml_tree<Node>::find_not_in(const std::vector<xml_name>& name_not_in) const {
+  return find_not_in_tree<Node>(*this, name_not_in);
+}
+
+template <typename Node> xml_writer& operator<<(xml_writer& writer, const xml_tree<Node>& tree) {
+  for (auto cit = tree.cbegin(); cit != tree.cend() && writer; ++cit)
+    writer << *cit;
+  return writer;
+}
+
 template <typename Node> std::ostream& operator<<(std::ostream& os, const xml_tree<Node>& tree) {
-  for (auto cit = tree.cbegin(); cit != tree.cend(); ++cit)
-    os << *cit;
-  return os;
+  xml_writer writer;
+  writer << tree;
+  return os << writer;
 }
+
+// a document's root node together with the arena owning it and everything below it
+template <typename Node> class xml_doc {
+  std::unique_ptr<xml_arena> arena;
+  Node* root;
+
+ public:
+  xml_doc() : root{} {}
+  xml_doc(std::unique_ptr<xml_arena>&& arena, Node* root) : arena{std::move(arena)}, root{root} {}
+  xml_doc(xml_doc&& that) : arena{std::move(that.arena)}, root{that.root} { that.root = nullptr; }
+  xml_doc& operator=(xml_doc&& that) {
+    arena = std::move(that.arena);
+    root = that.root;
+    that.root = nullptr;
+    return *this;
+  }
+
+  explicit operator bool() const { return root; }
+  const Node* get() const { return root; }
+  const Node& operator*() const { return *root; }
+  const Node* operator->() const { return root; }
+};
+
+// builds a document in document order (as a SAX parser reports it) into a fresh arena per document
+template <typename Node> class xml_doc_builder {
+  std::unique_ptr<xml_arena> arena;
+  Node* root;
+  std::vector<Node*> nodep_stack;
+  unsigned int base_level;
+
+ public:
+  xml_doc_builder() : root{}, base_level{} {}
+
+  // base_level: the root's level, for a document that is one subtree of a larger one
+  void reset(unsigned int base_level = 0);
+  xml_arena& get_arena() { return *arena; }
+  bool has_root() const { return root; }
+  bool in_node() const { return !nodep_stack.empty(); }
+
+  void start_node(unsigned int lineno, xml_name name, xml_text comment);
+  // returns true if chars are the node's first content
+  bool add_content(const char* chars, std::size_t len);
+  // a built node is written from its content and subtree, whatever its bytes in the document: only a flat node keeps them
+  void set_source(const char* chars, std::size_t len) {}
+  void end_node() { nodep_stack.pop_back(); }
+
+  xml_doc<Node> doc();
+};
+
+template <typename Node>
+void
+xml_doc_builder<Node>::reset(unsigned int base_level) {
+  arena.reset(new xml_arena{});
+  root = nullptr;
+  nodep_stack.clear();
+  this->base_level = base_level;
+}
+
+template <typename Node>
+void
+xml_doc_builder<Node>::start_node(unsigned int lineno, xml_name name, xml_text comment) {
+  if (!root) {
+    assert(nodep_stack.empty());
+    nodep_stack.push_back(root = arena->make<Node>(*arena, lineno, base_level, name, comment));
+  } else {
+    assert(!nodep_stack.empty() && !nodep_stack.back()->get_content());
+    nodep_stack.push_back(nodep_stack.back()->add_subnode(Node{*arena, lineno, nodep_stack.back()->level + 1, name, comment}));
+  }
+}
+
+template <typename Node>
+bool
+xml_doc_builder<Node>::add_content(const char* chars, std::size_t len) {
+  Node* const nodep = nodep_stack.back();
+  assert(!nodep->tree());
+  if (nodep->get_content()) {
+    nodep->append_content(chars, len);
+    return false;
+  }
+  nodep->set_content(chars, len);
+  return true;
+}
+
+template <typename Node>
+xml_doc<Node>
+xml_doc_builder<Node>::doc() {
+  assert(nodep_stack.empty());
+  Node* const doc_root = root;
+  root = nullptr;
+  return xml_doc<Node>{std::move(arena), doc_root};
+}
+
+class xml_node;
+template <> class xml_doc_builder<xml_node>;
+
+template <> class xml_tree_iterator<xml_node> {
+  const xml_node* nodep;
+
+ public:
+  xml_tree_iterator(const xml_node* nodep) : nodep{nodep} {}
+
+  xml_tree_iterator operator++();
+  bool operator==(const xml_tree_iterator& that) const { return that.nodep == nodep; }
+  bool operator!=(const xml_tree_iterator& that) const { return that.nodep != nodep; }
+  const xml_node& operator*() const { return *nodep; }
+  const xml_node* operator->() const { return nodep; }
+};
+
+// a flat node's subnodes; tree() hands these out by value, and operator-> lets them stand in for basic_xml_node::tree()'s pointers
+template <> class xml_tree<xml_node> {
+  const xml_node* first;
+  const xml_node* last;
+  unsigned int cnt;
+
+ public:
+  xml_tree(const xml_node* first, const xml_node* last, unsigned int cnt) : first{first}, last{last}, cnt{cnt} {}
+
+  explicit operator bool() const { return cnt; }
+  const xml_tree* operator->() const { return this; }
+
+  unsigned int node_cnt() const { return cnt; }
+  xml_tree_iterator<xml_node> cbegin() const { return xml_tree_iterator<xml_node>{first}; }
+  xml_tree_iterator<xml_node> cend() const { return xml_tree_iterator<xml_node>{last}; }
+
+  std::vector<const xml_node*> find_in(const std::vector<xml_name>& name_in) const { return find_in_tree<xml_node>(*this, name_in); }
+  std::vector<const xml_node*> find_not_in(const std::vector<xml_name>& name_not_in) const { return find_not_in_tree<xml_node>(*this, name_not_in); }
+};
+
+// immutable node of a flat document: the nodes of a document form one array in document order, each node followed by all of its
+// descendants, with all text in the document's arena
+class xml_node {
+  friend class xml_doc_builder<xml_node>;
+  friend class xml_tree_iterator<xml_node>;
+
+  xml_arena* const arena;
+
+ public:
+  const unsigned int lineno;
+  const unsigned int level;
+  const xml_name name;
+  const xml_text comment;
+
+ private:
+  xml_text content;
+  // the node's bytes in the document it was parsed from (which must outlive it), if the parser knew them
+  xml_text source;
+  unsigned int subnode_cnt;
+  // this node and all of its descendants: the next sibling is span nodes on
+  unsigned int span;
+
+ public:
+  xml_node(xml_arena& arena, unsigned int lineno, unsigned int level, xml_name name, xml_text comment = xml_text{}) : arena{&arena}, lineno{lineno}, level{level}, name{name}, comment{comment}, subnode_cnt{}, span{1} {}
+
+  bool operator==(const xml_node& that) const { return level == that.level && name == that.name; }
+  bool operator<(const xml_node& that) const { return level < that.level || (level == that.level && name < that.name); }
+
+  xml_arena& get_arena() const { return *arena; }
+
+  const xml_text& get_content() const { return content; }
+  const xml_text& get_source() const { return source; }
+  xml_tree<xml_node> tree() const { return xml_tree<xml_node>{this + 1, this + span, subnode_cnt}; }
+  unsigned int get_span() const { return span; }
+
+  // the nodes are written front to back, each open one closed once the last node of its span is: nothing recurses, however deep
+  // the nesting
+  friend xml_writer& operator<<(xml_writer& writer, const xml_node& node) {
+    std::vector<const xml_node*> open_nodes;
+    const xml_node* const end{&node + node.span};
+    for (const xml_node* nodep{&node}; nodep != end && writer; ++nodep) {
+      if (nodep->comment) {
+        writer.indent(nodep->level);
+        writer << "<!--" << nodep->comment << "-->";
+        writer.newline();
+      }
+      writer.indent(nodep->level);
+      writer << '<' << nodep->name << '>';
+      if (nodep->subnode_cnt) {
+        writer.newline();
+        open_nodes.push_back(nodep);
+        continue;
+      }
+      if (nodep->content)
+        writer << nodep->content;
+      writer << "</" << nodep->name << '>';
+      writer.newline();
+      while (!open_nodes.empty() && nodep + 1 == open_nodes.back() + open_nodes.back()->span) {
+        writer.indent(open_nodes.back()->level);
+        writer << "</" << open_nodes.back()->name << '>';
+        writer.newline();
+        open_nodes.pop_back();
+      }
+    }
+    // only left open if the writer gave up early
+    for (; !open_nodes.empty(); open_nodes.pop_back()) {
+      writer.indent(open_nodes.back()->level);
+      writer << "</" << open_nodes.back()->name << '>';
+      writer.newline();
+    }
+    return writer;
+  }
+  friend std::ostream& operator<<(std::ostream& os, const xml_node& node) {
+    xml_writer writer;
+    writer << node;
+    return os << writer;
+  }
+};
+
+inline xml_tree_iterator<xml_node>
+xml_tree_iterator<xml_node>::operator++() {
+  nodep += nodep->span;
+  return *this;
+}
+
+// appends nodes to one reusable array, which is copied into the document's arena once the document is complete
+template <> class xml_doc_builder<xml_node> {
+  std::unique_ptr<xml_arena> arena;
+  std::vector<xml_node> nodes;
+  std::vector<std::size_t> node_stack;
+  unsigned int base_level;
+
+ public:
+  xml_doc_builder() : base_level{} {}
+
+  void reset(unsigned int base_level = 0) {
+    arena.reset(new xml_arena{});
+    nodes.clear();
+    node_stack.clear();
+    this->base_level = base_level;
+  }
+  xml_arena& get_arena() { return *arena; }
+  bool has_root() const { return !nodes.empty(); }
+  bool in_node() const { return !node_stack.empty(); }
+
+  void start_node(unsigned int lineno, xml_name name, xml_text comment) {
+    assert(nodes.empty() == node_stack.empty());
+    if (!node_stack.empty()) {
+      assert(!nodes[node_stack.back()].content);
+      ++nodes[node_stack.back()].subnode_cnt;
+    }
+    node_stack.push_back(nodes.size());
+    nodes.emplace_back(*arena, lineno, static_cast<unsigned int>(base_level + node_stack.size() - 1), name, comment);
+  }
+  bool add_content(const char* chars, std::size_t len) {
+    xml_node& node = nodes[node_stack.back()];
+    assert(!node.subnode_cnt);
+    if (node.content) {
+      node.content = arena->copy(node.content.str().append(chars, len));
+      return false;
+    }
+    node.content = arena->copy(chars, len);
+    return true;
+  }
+  void set_source(const char* chars, std::size_t len) { nodes[node_stack.back()].source = xml_text{chars, len}; }
+  void end_node() {
+    nodes[node_stack.back()].span = static_cast<unsigned int>(nodes.size() - node_stack.back());
+    node_stack.pop_back();
+  }
+
+  xml_doc<xml_node> doc() {
+    assert(node_stack.empty());
+    xml_node* root{};
+    if (!nodes.empty()) {
+      root = static_cast<xml_node*>(arena->allocate(nodes.size() * sizeof(xml_node), alignof(xml_node)));
+      std::uninitialized_copy(nodes.cbegin(), nodes.cend(), root);
+      nodes.clear();
+    }
+    return xml_doc<xml_node>{std::move(arena), root};
+  }
+};
 }
 #endif
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include "xml_name.h"
+
+namespace xml_graph {
+using namespace std;
+
+namespace {
+const char* const known_names[xml_names::known_cnt]{"activation", "activeByDefault", "activeProfile", "activeProfiles", "arch", "artifactId", "build", "ciManagement", "classifier", "comments", "configuration", "connection", "defaultGoal", "dependencies", "dependency", "dependencyManagement", "description", "developer", "developerConnection", "developers", "directory", "distribution", "distributionManagement", "email", "enabled", "exclude", "excludes", "exclusion", "exclusions", "execution", "executions", "exists", "extensions", "family", "file", "filtering", "finalName", "goal", "goals", "groupId", "id", "inceptionYear", "include", "includes", "inherited", "issueManagement", "jdk", "layout", "license", "licenses", "maven", "missing", "modelVersion", "module", "modules", "name", "optional", "organization", "os", "outputDirectory", "packaging", "parent", "phase", "plugin", "pluginManagement", "pluginRepositories", "pluginRepository", "plugins", "prerequisites", "profile", "profiles", "project", "properties", "property", "relativePath", "releases", "reporting", "repositories", "repository", "resource", "resources", "role", "roles", "scm", "scope", "site", "snapshotRepository", "snapshots", "sourceDirectory", "system", "systemPath", "tag", "targetPath", "testResource", "testResources", "testSourceDirectory", "timezone", "type", "uniqueVersion", "updatePolicy", "url", "value", "version"};
+
+inline uint32_t
+hash_name(const char* name, size_t len, uint32_t seed) {
+  uint32_t h{2166136261U ^ seed};
+  for (size_t i = 0; i < len; ++i)
+    h = (h ^ static_cast<unsigned char>(name[i])) * 16777619U;
+  return h;
+}
+
+// a collision-free (perfect) hash of the known names, seeded at startup; a lookup costs one hash and one string compare
+class known_symbol_table {
+  static const size_t slot_cnt = 1024;
+
+  vector<xml_symbol> symbols;
+  uint32_t seed;
+  const xml_symbol* slots[slot_cnt];
+
+  bool place_symbols() {
+    fill(begin(slots), end(slots), nullptr);
+    for (const auto& symbol : symbols) {
+      const xml_symbol*& slot = slots[hash_name(symbol.str.data(), symbol.str.size(), seed) & (slot_cnt - 1)];
+      if (slot)
+        return false;
+      slot = &symbol;
+    }
+    return true;
+  }
+
+ public:
+  known_symbol_table() : seed{} {
+    symbols.reserve(xml_names::known_cnt);
+    for (auto id = 0U; id < xml_names::known_cnt; ++id)
+      symbols.emplace_back(id, known_names[id]);
+    while (!place_symbols())
+      ++seed;
+  }
+
+  const xml_symbol* find(const char* name, size_t len) const {
+    const xml_symbol* const symbol = slots[hash_name(name, len, seed) & (slot_cnt - 1)];
+    return symbol && symbol->str.size() == len && !memcmp(symbol->str.data(), name, len) ? symbol : nullptr;
+  }
+
+  const xml_symbol* get(unsigned int id) const { return &symbols[id]; }
+};
+
+const known_symbol_table&
+known_symbols() {
+  static const known_symbol_table symbols{};
+  return symbols;
+}
+
+// a name to look up by, without copying it
+struct name_key {
+  const char* chars;
+  size_t len;
+
+  bool operator==(const name_key& that) const { return len == that.len && !memcmp(chars, that.chars, len); }
+};
+
+struct name_key_hash {
+  size_t operator()(const name_key& key) const { return hash_name(key.chars, key.len, 0); }
+};
+
+// the interned symbols' own strings are the keys, so a lookup allocates nothing
+using symbol_map = unordered_map<name_key, const xml_symbol*, name_key_hash>;
+
+// names outside the POM vocabulary (e.g. plugin configuration keys), interned as they are met, until released all at once
+class dynamic_symbol_table {
+  mutex symbols_mutex;
+  deque<xml_symbol> symbols;
+  symbol_map symbols_by_name;
+
+ public:
+  // bumped by every release, so that each thread's cache knows to forget the symbols it holds
+  atomic<unsigned int> generation;
+
+  dynamic_symbol_table() : generation{} {}
+
+  const xml_symbol* intern(const char* name, size_t len) {
+    lock_guard<mutex> lock{symbols_mutex};
+    const auto cit = symbols_by_name.find(name_key{name, len});
+    if (cit != symbols_by_name.cend())
+      return cit->second;
+    symbols.emplace_back(static_cast<unsigned int>(xml_names::known_cnt + symbols.size()), string{name, len});
+    const xml_symbol* const symbol = &symbols.back();
+    symbols_by_name.emplace(name_key{symbol->str.data(), symbol->str.size()}, symbol);
+    return symbol;
+  }
+
+  void release() {
+    lock_guard<mutex> lock{symbols_mutex};
+    symbols_by_name.clear();
+    symbols.clear();
+    ++generation;
+  }
+};
+
+dynamic_symbol_table&
+dynamic_symbols() {
+  static dynamic_symbol_table symbols{};
+  return symbols;
+}
+
+// the dynamic symbols the calling thread has met, so that the shared table (and its lock) is only visited once per thread and name
+struct thread_symbol_cache {
+  unsigned int generation;
+  symbol_map symbols_by_name;
+};
+
+thread_local thread_symbol_cache symbol_cache;
+}
+
+const xml_symbol*
+xml_name::intern(const char* name, size_t len) {
+  if (const xml_symbol* const symbol = known_symbols().find(name, len))
+    return symbol;
+  dynamic_symbol_table& symbols = dynamic_symbols();
+  const unsigned int generation{symbols.generation.load(memory_order_acquire)};
+  if (symbol_cache.generation != generation) {
+    symbol_cache.symbols_by_name.clear();
+    symbol_cache.generation = generation;
+  }
+  const auto cit = symbol_cache.symbols_by_name.find(name_key{name, len});
+  if (cit != symbol_cache.symbols_by_name.cend())
+    return cit->second;
+  const xml_symbol* const symbol = symbols.intern(name, len);
+  symbol_cache.symbols_by_name.emplace(name_key{symbol->str.data(), symbol->str.size()}, symbol);
+  return symbol;
+}
+
+void
+xml_name::release_dynamic() {
+  dynamic_symbols().release();
+}
+
+xml_name::xml_name(xml_names::ids id) : sym{known_symbols().get(id)} {}
+}
@@ -0,0 +1,51 @@
+#ifndef XML_NAME_H
+#define XML_NAME_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace xml_graph {
+
+// the POM vocabulary, interned up front; ids are in name order, so comparing ids of known names orders them by name
+struct xml_names {
+  enum ids : unsigned int { activation = 0, active_by_default, active_profile, active_profiles, arch, artifact_id, build, ci_management, classifier, comments, configuration, connection, default_goal, dependencies, dependency, dependency_management, description, developer, developer_connection, developers, directory, distribution, distribution_management, email, enabled, exclude, excludes, exclusion, exclusions, execution, executions, exists, extensions, family, file, filtering, final_name, goal, goals, group_id, id, inception_year, include, includes, inherited, issue_management, jdk, layout, license, licenses, maven, missing, model_version, module, modules, name, optional, organization, os, output_directory, packaging, parent, phase, plugin, plugin_management, plugin_repositories, plugin_repository, plugins, prerequisites, profile, profiles, project, properties, property, relative_path, releases, reporting, repositories, repository, resource, resources, role, roles, scm, scope, site, snapshot_repository, snapshots, source_directory, system, system_path, tag, target_path, test_resource, test_resources, test_source_directory, timezone, type, unique_version, update_policy, url, value, version, known_cnt };
+};
+
+struct xml_symbol {
+  const unsigned int id;
+  const std::string str;
+
+  xml_symbol(unsigned int id, const std::string& str) : id{id}, str{str} {}
+};
+
+// an interned element name: equal names share one xml_symbol, so equality is a pointer compare
+class xml_name {
+  const xml_symbol* sym;
+
+  static const xml_symbol* intern(const char* name, std::size_t len);
+
+ public:
+  xml_name(xml_names::ids id);
+  xml_name(const char* name, std::size_t len) : sym{intern(name, len)} {}
+  explicit xml_name(const std::string& name) : sym{intern(name.data(), name.size())} {}
+
+  // forgets every name outside the POM vocabulary, for a long-running process to bound its memory: only while no xml_name of
+  // such a name is alive, on any thread
+  static void release_dynamic();
+
+  unsigned int id() const { return sym->id; }
+  bool known() const { return sym->id < xml_names::known_cnt; }
+  const std::string& str() const { return sym->str; }
+
+  bool operator==(const xml_name& that) const { return sym == that.sym; }
+  bool operator!=(const xml_name& that) const { return sym != that.sym; }
+  bool operator==(xml_names::ids id) const { return sym->id == id; }
+  bool operator!=(xml_names::ids id) const { return sym->id != id; }
+  // orders by name, as plain strings would
+  bool operator<(const xml_name& that) const { return known() && that.known() ? sym->id < that.sym->id : sym->str < that.sym->str; }
+
+  friend std::ostream& operator<<(std::ostream& os, const xml_name& name) { return os << name.sym->str; }
+};
+}
+#endif
@@ -1,23 +1,381 @@
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
+#include <xercesc/sax/SAXParseException.hpp>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
 #include <xercesc/util/XMLString.hpp>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "xml_parser.h"
 
 namespace xml_parser {
 using namespace std;
 using namespace xercesc_3_1;
 
+namespace {
+thread_local xml_parse_counters parse_counters;
+// null for std::cerr
+thread_local ostream* diagnostics_os;
+
+// whitespace as classified by isspace() in the "C" locale: '\t', '\n', '\v', '\f', '\r' and ' '
+inline bool
+is_space(XMLCh c) {
+  return c == 0x20 || static_cast<unsigned int>(c - 0x09) <= 0x04;
+}
+
+#if defined(__AVX2__)
+const XMLSize_t simd_width = 16;
+const unsigned int all_spaces = 0xFFFFFFFF;
+
+// bit i*2 (and i*2+1) of the returned masks is set for XMLCh i of the block
+inline unsigned int
+space_mask(const XMLCh* buf, unsigned int& nl_mask) {
+  const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf));
+  const __m256i ctrl = _mm256_subs_epu16(_mm256_sub_epi16(chars, _mm256_set1_epi16(0x09)), _mm256_set1_epi16(0x04));
+  const __m256i spaces = _mm256_or_si256(_mm256_cmpeq_epi16(ctrl, _mm256_setzero_si256()), _mm256_cmpeq_epi16(chars, _mm256_set1_epi16(0x20)));
+  nl_mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(chars, _mm256_set1_epi16(0x0A))));
+  return static_cast<unsigned int>(_mm256_movemask_epi8(spaces));
+}
+
+inline bool
+is_ascii(const XMLCh* buf) {
+  const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(buf));
+  return _mm256_testz_si256(chars, _mm256_set1_epi16(static_cast<short>(0xFF80)));
+}
+
+inline void
+narrow_ascii(const XMLCh* buf, char* cp) {
+  const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf)), hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 8));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(cp), _mm_packus_epi16(lo, hi));
+}
+#elif defined(__SSE2__)
+const XMLSize_t simd_width = 8;
+const unsigned int all_spaces = 0xFFFF;
+
+inline unsigned int
+space_mask(const XMLCh* buf, unsigned int& nl_mask) {
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+  const __m128i ctrl = _mm_subs_epu16(_mm_sub_epi16(chars, _mm_set1_epi16(0x09)), _mm_set1_epi16(0x04));
+  const __m128i spaces = _mm_or_si128(_mm_cmpeq_epi16(ctrl, _mm_setzero_si128()), _mm_cmpeq_epi16(chars, _mm_set1_epi16(0x20)));
+  nl_mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi16(chars, _mm_set1_epi16(0x0A))));
+  return static_cast<unsigned int>(_mm_movemask_epi8(spaces));
+}
+
+inline bool
+is_ascii(const XMLCh* buf) {
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+  const __m128i high_bits = _mm_and_si128(chars, _mm_set1_epi16(static_cast<short>(0xFF80)));
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(high_bits, _mm_setzero_si128())) == 0xFFFF;
+}
+
+inline void
+narrow_ascii(const XMLCh* buf, char* cp) {
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(cp), _mm_packus_epi16(chars, chars));
+}
+#endif
+
+// narrows buf into s if it is pure ASCII (the common case in a POM); returns false, leaving s unspecified, otherwise
+bool
+narrow_if_ascii(const XMLCh* buf, XMLSize_t len, string& s) {
+  s.resize(len);
+  char* const cp = &s[0];
+  XMLSize_t i{};
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; i + simd_width <= len; i += simd_width) {
+    if (!is_ascii(buf + i))
+      return false;
+    narrow_ascii(buf + i, cp + i);
+  }
+#endif
+  for (; i < len; ++i) {
+    if (buf[i] >= 0x80)
+      return false;
+    cp[i] = static_cast<char>(buf[i]);
+  }
+  return true;
+}
+}
+
+xml_parse_counters&
+thread_parse_counters() {
+  return parse_counters;
+}
+
+ostream&
+thread_diagnostics() {
+  return diagnostics_os ? *diagnostics_os : cerr;
+}
+
+xml_diagnostics_redirect::xml_diagnostics_redirect(ostream& os) : prev_os{diagnostics_os} {
+  diagnostics_os = &os;
+}
+
+xml_diagnostics_redirect::~xml_diagnostics_redirect() {
+  diagnostics_os = prev_os;
+}
+
+int
+ignorable_newlines(const XMLCh* buf, XMLSize_t len) {
+  int nl_cnt{};
+  XMLSize_t i{};
+#if defined(__AVX2__) || defined(__SSE2__)
+  for (; i + simd_width <= len; i += simd_width) {
+    unsigned int nl_mask{};
+    if (space_mask(buf + i, nl_mask) != all_spaces)
+      return -1;
+    nl_cnt += __builtin_popcount(nl_mask) / 2;
+  }
+#endif
+  for (; i < len; ++i) {
+    if (!is_space(buf[i]))
+      return -1;
+    if (buf[i] == 0x0A)
+      ++nl_cnt;
+  }
+  return nl_cnt;
+}
+
+int
+ignorable_newlines(const char* chars, size_t len) {
+  int nl_cnt{};
+  for (size_t i{}; i < len; ++i) {
+    if (!is_space(static_cast<unsigned char>(chars[i])))
+      return -1;
+    if (chars[i] == '\n')
+      ++nl_cnt;
+  }
+  return nl_cnt;
+}
+
+void
+transcode(const XMLCh* buf, XMLSize_t len, string& s) {
+  if (!narrow_if_ascii(buf, len, s)) {
+    s.resize(3 * len + 1);
+    XMLString::transcode(buf, &s[0], 3 * len);
+    s.resize(strlen(s.c_str()));
+  }
+  parse_counters.transcoded_bytes += s.size();
+}
+
+bool
+utf8_source(const char* buf, size_t len) {
+  const char* p{buf};
+  const char* const end{buf + len};
+  if (len >= 3 && !memcmp(p, "\xEF\xBB\xBF", 3))
+    p += 3;
+  const auto skip_space = [&p, end]() {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+      ++p;
+  };
+  const auto at = [&p, end](const char* s) {
+    const size_t s_len{strlen(s)};
+    return static_cast<size_t>(end - p) >= s_len && !memcmp(p, s, s_len);
+  };
+  const auto skip_past = [&p, end](const char* s) {
+    const size_t s_len{strlen(s)};
+    for (; static_cast<size_t>(end - p) >= s_len; ++p) {
+      if (!memcmp(p, s, s_len)) {
+        p += s_len;
+        return true;
+      }
+    }
+    return false;
+  };
+  // anything else (UTF-16 or -32, with a byte order mark or not, or EBCDIC) can't even start with an ASCII '<'
+  if (p == end || (*p != '<' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'))
+    return false;
+  if (at("<?xml") && end - p > 5 && (p[5] == ' ' || p[5] == '\t' || p[5] == '\r' || p[5] == '\n')) {
+    const char* const decl{p};
+    if (!skip_past("?>"))
+      return false;
+    const string decl_str{decl, p};
+    const auto encoding_pos = decl_str.find("encoding");
+    if (encoding_pos != string::npos) {
+      const auto first = decl_str.find_first_of("\"'", encoding_pos);
+      const auto last = first == string::npos ? string::npos : decl_str.find(decl_str[first], first + 1);
+      if (last == string::npos)
+        return false;
+      string encoding{decl_str.substr(first + 1, last - first - 1)};
+      for (auto& c : encoding) {
+        if (c >= 'a' && c <= 'z')
+          c = static_cast<char>(c - 'a' + 'A');
+      }
+      if (encoding != "UTF-8" && encoding != "UTF8" && encoding != "US-ASCII" && encoding != "ASCII")
+        return false;
+    }
+  }
+  for (;;) {
+    skip_space();
+    if (at("<!--")) {
+      if (!skip_past("-->"))
+        return false;
+    } else if (at("<?")) {
+      if (!skip_past("?>"))
+        return false;
+    } else
+      // the root element (or something Xerces will reject anyway), unless it's a DOCTYPE
+      return !at("<!");
+  }
+}
+
+void
+xml_source_finder::reset(const SAX2XMLReader* reader, const char* buf, size_t len) {
+  this->reader = buf && utf8_source(buf, len) ? reader : nullptr;
+  this->buf = buf;
+  this->len = len;
+  start_tags.clear();
+}
+
+// a start tag ends in '>' and has no '<' in it (not even in an attribute value), so it starts at the last '<' before its end
+void
+xml_source_finder::start_element() {
+  if (!reader)
+    return;
+  const XMLFilePos offset{reader->getSrcOffset()};
+  const char* start_tag{};
+  if (offset && offset <= len && buf[offset - 1] == '>') {
+    for (const char* p{buf + offset - 1}; p != buf;) {
+      if (*--p == '<') {
+        if (p[1] != '/' && p[1] != '!' && p[1] != '?')
+          start_tag = p;
+        break;
+      }
+    }
+  }
+  start_tags.push_back(start_tag);
+}
+
+bool
+xml_source_finder::end_element(const char*& chars, size_t& chars_len) {
+  if (!reader || start_tags.empty())
+    return false;
+  const char* const start_tag{start_tags.back()};
+  start_tags.pop_back();
+  const XMLFilePos offset{reader->getSrcOffset()};
+  if (!start_tag || offset > len || buf + offset <= start_tag || buf[offset - 1] != '>')
+    return false;
+  chars = start_tag;
+  chars_len = static_cast<size_t>(buf + offset - start_tag);
+  return true;
+}
+
 xmlstring::xmlstring(const XMLCh* buf) {
   char* cp{XMLString::transcode(buf)};
   string::operator=(cp);
   XMLString::release(&cp);
+  parse_counters.transcoded_bytes += size();
 }
 
 xmlstring::xmlstring(const XMLCh* buf, XMLSize_t len) {
-  char* const cp = new char[3 * len + 1];
-  XMLString::transcode(buf, cp, 3 * len);
-  string::operator=(cp);
-  delete[] cp;
+  transcode(buf, len, *this);
+}
+
+void
+xml_utf8_delegator::characters(const XMLCh* const buf, const XMLSize_t len) {
+  ++parse_counters.characters_cnt;
+  if (ignorable_newlines(buf, len) < 0) {
+    transcode(buf, len, chars_buf);
+    handler.handle_utf8_content(locator->getLineNumber(), chars_buf.data(), chars_buf.size());
+  }
+}
+
+void
+xml_utf8_delegator::startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) {
+  source_finder.start_element();
+  transcode(qname, XMLString::stringLen(qname), name_buf);
+  handler.handle_utf8_start_element(locator->getLineNumber(), name_buf.data(), name_buf.size());
+}
+
+void
+xml_utf8_delegator::endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) {
+  const char* chars;
+  size_t len;
+  if (source_finder.end_element(chars, len))
+    handler.handle_utf8_element_source(chars, len);
+  transcode(qname, XMLString::stringLen(qname), name_buf);
+  handler.handle_utf8_end_element(locator->getLineNumber(), name_buf.data(), name_buf.size());
+}
+
+void
+xml_utf8_delegator::comment(const XMLCh* const buf, const XMLSize_t len) {
+  transcode(buf, len, chars_buf);
+  handler.handle_utf8_comment(locator->getLineNumber(), chars_buf.data(), chars_buf.size());
+}
+
+void
+xml_utf8_delegator::processingInstruction(const XMLCh* const target, const XMLCh* const data) {
+  transcode(target, XMLString::stringLen(target), name_buf);
+  transcode(data, XMLString::stringLen(data), chars_buf);
+  handler.handle_utf8_processing_instruction(locator->getLineNumber(), name_buf.data(), name_buf.size(), chars_buf.data(), chars_buf.size());
+}
+
+void
+xml_utf8_delegator::warning(const SAXParseException& e) {
+  thread_diagnostics() << "warning at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << endl;
+}
+
+void
+xml_utf8_delegator::error(const SAXParseException& e) {
+  thread_diagnostics() << "error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << endl;
+}
+
+void
+xml_utf8_delegator::fatalError(const SAXParseException& e) {
+  thread_diagnostics() << "fatal error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << endl;
+}
+
+xml_stream_parser::xml_stream_parser(xml_utf8_handler& handler) : delegator{handler}, parser{XMLReaderFactory::createXMLReader()}, parsing{} {
+  parser->setFeature(XMLUni::fgSAX2CoreValidation, false);
+  parser->setFeature(XMLUni::fgSAX2CoreNameSpaces, false);
+  parser->setFeature(XMLUni::fgXercesCalculateSrcOfs, true);
+
+  parser->setContentHandler(&delegator);
+  parser->setErrorHandler(&delegator);
+  parser->setLexicalHandler(&delegator);
+}
+
+void
+xml_stream_parser::start(const char* buf, size_t len, const char* system_id) {
+  stop();
+  this->system_id = system_id;
+  input_source.reset(new MemBufInputSource{reinterpret_cast<const XMLByte*>(buf), len, system_id, false});
+  input_source->setCopyBufToStream(false);
+  delegator.get_source_finder().reset(parser.get(), buf, len);
+  parsing = parser->parseFirst(*input_source, token);
+  if (!parsing || parser->getErrorCount()) {
+    stop();
+    throw runtime_error{"can't parse '" + this->system_id + '\''};
+  }
+}
+
+bool
+xml_stream_parser::next() {
+  if (!parsing)
+    return false;
+  // once the document is done (or has failed) Xerces has reset itself: only an abandoned parse needs parseReset()
+  parsing = parser->parseNext(token);
+  if (parser->getErrorCount()) {
+    stop();
+    throw runtime_error{"can't parse '" + system_id + '\''};
+  }
+  return parsing;
+}
+
+void
+xml_stream_parser::stop() {
+  if (parsing) {
+    parser->parseReset(token);
+    parsing = false;
+  }
 }
 }
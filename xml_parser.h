@@ -2,40 +2,99 @@
 #define XML_PARSER_H
 
 #include <cassert>
-#include <cctype>
+#include <cstddef>
 #include <iostream>
 #include <memory>
-#include <stack>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include <xercesc/framework/MemBufInputSource.hpp>
+#include <xercesc/framework/XMLPScanToken.hpp>
 #include <xercesc/sax/Locator.hpp>
 #include <xercesc/sax/SAXParseException.hpp>
 #include <xercesc/sax2/DefaultHandler.hpp>
 #include <xercesc/sax2/SAX2XMLReader.hpp>
 #include <xercesc/sax2/XMLReaderFactory.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
+#include <xercesc/util/XMLString.hpp>
 #include <xercesc/util/XMLUni.hpp>
 
+#include "xml_arena.h"
+#include "xml_graph.h"
+#include "xml_name.h"
+#include "xml_scanner.h"
+
 namespace xercesc_3_1 {
 class Attributes;
 }
-namespace xml_graph {
-struct xml_node;
-}
-
 namespace xml_parser {
 
+// returns the number of newlines if buf is whitespace only (i.e. ignorable between elements), otherwise -1
+int ignorable_newlines(const XMLCh* buf, XMLSize_t len);
+int ignorable_newlines(const char* chars, std::size_t len);
+// transcodes buf into s, reusing its storage; pure-ASCII input is narrowed directly without the transcoder
+void transcode(const XMLCh* buf, XMLSize_t len, std::string& s);
+
+// what parsing has cost the calling thread so far (for --stats); only ever incremented, so callers diff two snapshots; a native
+// parse adds its xml_scan_counters once it has scanned the whole document
+struct xml_parse_counters {
+  std::size_t characters_cnt;
+  std::size_t transcoded_bytes;
+};
+
+xml_parse_counters& thread_parse_counters();
+
+// where parsing on the calling thread reports what it works around or fails on (Xerces' warnings and errors, discarded comments):
+// std::cerr, unless redirected to keep each file's diagnostics with the rest of what's reported about it
+std::ostream& thread_diagnostics();
+
+// redirects the calling thread's diagnostics to os while it lives
+class xml_diagnostics_redirect {
+  std::ostream* const prev_os;
+
+ public:
+  explicit xml_diagnostics_redirect(std::ostream& os);
+  ~xml_diagnostics_redirect();
+  xml_diagnostics_redirect(const xml_diagnostics_redirect&) = delete;
+  xml_diagnostics_redirect& operator=(const xml_diagnostics_redirect&) = delete;
+};
+
 struct xmlstring : public std::string {
   xmlstring(const XMLCh* buf);
   xmlstring(const XMLCh* buf, XMLSize_t len);
   xmlstring(const std::string& that) : std::string{that} {}
 };
 
-template <typename Node> struct basic_xml_doc_handler {
-  virtual ~basic_xml_doc_handler() {}
+// whether the document's bytes are the UTF-8 they stand for, so that parts of it can be copied to output as they are: nothing
+// but UTF-8 (or ASCII) by byte order mark or declaration, and no DTD, whose entities and default attributes the bytes would lack
+bool utf8_source(const char* buf, std::size_t len);
+
+// finds each element Xerces reports in the document's bytes, by the reader's offset just past its start tag and just past its
+// end tag, for handle_utf8_element_source(); only in a utf8_source() document, and only tags that end where they're found to
+class xml_source_finder {
+  const xercesc::SAX2XMLReader* reader;
+  const char* buf;
+  std::size_t len;
+  // each open element's start tag, or null if it wasn't found
+  std::vector<const char*> start_tags;
+
+ public:
+  xml_source_finder() : reader{}, buf{}, len{} {}
+
+  // before reader parses buf, which may be null (for a document read from a file) to find nothing
+  void reset(const xercesc::SAX2XMLReader* reader, const char* buf, std::size_t len);
+  void start_element();
+  // false if the element about to end wasn't found
+  bool end_element(const char*& chars, std::size_t& chars_len);
+};
 
+// a handler takes both Xerces' events and xml_scanner's
+template <typename Node> struct basic_xml_doc_handler : public xml_utf8_handler {
   virtual void handle_content(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) = 0;
+  virtual void handle_start_document(const xercesc::Locator& locator) = 0;
   virtual void handle_end_document(const xercesc::Locator& locator) = 0;
   virtual void handle_start_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) = 0;
   virtual void handle_end_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) = 0;
@@ -45,164 +104,195 @@ template <typename Node> struct basic_xml_doc_handler {
   virtual void handle_error(const xercesc::SAXParseException& e) = 0;
   virtual void handle_fatal_error(const xercesc::SAXParseException& e) = 0;
 
-  virtual std::unique_ptr<const Node> doc() = 0;
+  virtual xml_graph::xml_doc<Node> doc() = 0;
 };
 
 using xml_doc_handler = basic_xml_doc_handler<xml_graph::xml_node>;
 
+// Xerces' events are transcoded and handled as xml_scanner's are
 template <typename Node> class basic_default_xml_doc_handler : public basic_xml_doc_handler<Node> {
   std::string node_path;
-  std::unique_ptr<const std::string> node_comment;
-  std::stack<Node*> nodep_stack;
-  std::unique_ptr<Node> root_node;
+  std::string content_buf;
+  std::string name_buf;
+  xml_graph::xml_text node_comment;
+  xml_graph::xml_doc_builder<Node> doc_builder;
 
-  static int ignorable_newlines(const std::string& content);
+  void end_element(unsigned long lineno);
 
   void handle_content(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) override;
-  void handle_end_document(const xercesc::Locator& locator) override;
+  void handle_start_document(const xercesc::Locator& locator) override { handle_utf8_start_document(); }
+  void handle_end_document(const xercesc::Locator& locator) override { handle_utf8_end_document(locator.getLineNumber()); }
   void handle_start_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) override;
   void handle_end_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override;
   void handle_comment(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t cnt) override;
-  void handle_processing_instruction(const xercesc::Locator& locator, const XMLCh* const target, const XMLCh* const data) override;
+  void handle_processing_instruction(const xercesc::Locator& locator, const XMLCh* const target, const XMLCh* const data) override {}
   void handle_warning(const xercesc::SAXParseException& e) override;
   void handle_error(const xercesc::SAXParseException& e) override;
   void handle_fatal_error(const xercesc::SAXParseException& e) override;
 
-  std::unique_ptr<const Node> doc() override { return std::move(root_node); }
+  void handle_utf8_start_document() override;
+  void handle_utf8_end_document(unsigned long lineno) override;
+  void handle_utf8_start_element(unsigned long lineno, const char* name, std::size_t len) override;
+  void handle_utf8_end_element(unsigned long lineno, const char* name, std::size_t len) override;
+  void handle_utf8_content(unsigned long lineno, const char* chars, std::size_t len) override;
+  void handle_utf8_comment(unsigned long lineno, const char* chars, std::size_t len) override;
+  void handle_utf8_processing_instruction(unsigned long lineno, const char* target, std::size_t target_len, const char* data, std::size_t data_len) override {}
+  void handle_utf8_element_source(const char* chars, std::size_t len) override { doc_builder.set_source(chars, len); }
+
+  xml_graph::xml_doc<Node> doc() override { return doc_builder.doc(); }
 };
 
 template <typename Node>
-int
-basic_default_xml_doc_handler<Node>::ignorable_newlines(const std::string& content) {
-  int nl_cnt{};
-  for (const auto c : content) {
-    if (!isspace(c))
-      return -1;
-    if (c == '\n')
-      ++nl_cnt;
+void
+basic_default_xml_doc_handler<Node>::handle_content(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) {
+  // whitespace between elements is by far the most frequent content: classify it before transcoding anything
+  if (ignorable_newlines(buf, len) < 0) {
+    transcode(buf, len, content_buf);
+    handle_utf8_content(locator.getLineNumber(), content_buf.data(), content_buf.size());
   }
-  return nl_cnt;
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_content(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) {
-  const xmlstring content{buf, len};
-  const int nl_cnt{ignorable_newlines(content)};
-  if (nl_cnt < 0) {
-    assert(!node_path.empty());
-    auto* const nodep = nodep_stack.top();
-    assert(!nodep->tree());
-    if (nodep->get_content())
-      nodep->append_content(xmlstring{content});
-    else {
-      nodep->set_content(xmlstring{content});
-      node_comment.reset();
-    }
-  }
+basic_default_xml_doc_handler<Node>::handle_start_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) {
+  transcode(qname, xercesc::XMLString::stringLen(qname), name_buf);
+  handle_utf8_start_element(locator.getLineNumber(), name_buf.data(), name_buf.size());
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_end_document(const xercesc::Locator& locator) {
-  assert(node_path.empty() && nodep_stack.empty());
-  if (node_comment) {
-    std::cerr << "discarding comment before document end; line " << locator.getLineNumber() << std::endl;
-    node_comment.reset();
-  }
-  assert(root_node);
+basic_default_xml_doc_handler<Node>::handle_end_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) {
+  assert(xmlstring{qname} == node_path.substr(node_path.rfind('/') + 1));
+  end_element(locator.getLineNumber());
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_start_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) {
-  Node* nodep{};
-  if (!root_node) {
-    assert(nodep_stack.empty());
-    root_node.reset(new Node{static_cast<unsigned short>(locator.getLineNumber()), 0, xmlstring{qname}, node_comment.get()});
-    nodep = root_node.get();
-  } else {
-    assert(!nodep_stack.empty() && !nodep_stack.top()->get_content());
-    nodep = nodep_stack.top()->add_subnode(Node{static_cast<unsigned short>(locator.getLineNumber()), static_cast<unsigned short>(nodep_stack.top()->level + 1), xmlstring{qname}, node_comment.get()});
-  }
-  node_comment.reset();
-  nodep_stack.push(nodep);
-
-  node_path += '/' + xmlstring{qname};
+basic_default_xml_doc_handler<Node>::handle_comment(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) {
+  transcode(buf, len, content_buf);
+  handle_utf8_comment(locator.getLineNumber(), content_buf.data(), content_buf.size());
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_end_element(const xercesc::Locator& locator, const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) {
-  const std::string::size_type pos{node_path.rfind('/')};
-  assert(pos != std::string::npos && xmlstring{qname} == node_path.substr(pos + 1));
-  if (node_comment) {
-    std::cerr << "discarding comment before '" + node_path + "' end; line " << locator.getLineNumber() << std::endl;
-    node_comment.reset();
-  }
-
-  assert(!nodep_stack.empty());
-  nodep_stack.pop();
-
-  node_path = node_path.substr(0, pos);
+basic_default_xml_doc_handler<Node>::handle_error(const xercesc::SAXParseException& e) {
+  thread_diagnostics() << "error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_comment(const xercesc::Locator& locator, const XMLCh* const buf, const XMLSize_t len) {
-  node_comment.reset(new xmlstring{buf, len});
+basic_default_xml_doc_handler<Node>::handle_fatal_error(const xercesc::SAXParseException& e) {
+  thread_diagnostics() << "fatal error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_processing_instruction(const xercesc::Locator& locator, const XMLCh* const target, const XMLCh* const data) {}
+basic_default_xml_doc_handler<Node>::handle_warning(const xercesc::SAXParseException& e) {
+  thread_diagnostics() << "warning at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
+}
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_error(const xercesc::SAXParseException& e) {
-  std::cerr << "error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
+basic_default_xml_doc_handler<Node>::handle_utf8_start_document() {
+  // handlers are reused across documents (and parsers): drop any state left behind by a failed parse
+  node_path.clear();
+  node_comment = xml_graph::xml_text{};
+  doc_builder.reset();
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_fatal_error(const xercesc::SAXParseException& e) {
-  std::cerr << "fatal error at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
+basic_default_xml_doc_handler<Node>::handle_utf8_end_document(unsigned long lineno) {
+  assert(node_path.empty() && !doc_builder.in_node());
+  if (node_comment) {
+    thread_diagnostics() << "discarding comment before document end; line " << lineno << std::endl;
+    node_comment = xml_graph::xml_text{};
+  }
+  assert(doc_builder.has_root());
 }
 
 template <typename Node>
 void
-basic_default_xml_doc_handler<Node>::handle_warning(const xercesc::SAXParseException& e) {
-  std::cerr << "warning at file " << xmlstring{e.getSystemId()} << ", line " << e.getLineNumber() << ", col " << e.getColumnNumber() << ": " << xmlstring{e.getMessage()} << std::endl;
+basic_default_xml_doc_handler<Node>::handle_utf8_start_element(unsigned long lineno, const char* name, std::size_t len) {
+  doc_builder.start_node(static_cast<unsigned int>(lineno), xml_graph::xml_name{name, len}, node_comment);
+  node_comment = xml_graph::xml_text{};
+
+  node_path += '/';
+  node_path.append(name, len);
 }
 
-using default_xml_doc_handler = basic_default_xml_doc_handler<xml_graph::xml_node>;
+template <typename Node>
+void
+basic_default_xml_doc_handler<Node>::handle_utf8_end_element(unsigned long lineno, const char* name, std::size_t len) {
+  assert(node_path.compare(node_path.rfind('/') + 1, std::string::npos, name, len) == 0);
+  end_element(lineno);
+}
 
-template <typename Node> class basic_xml_doc_parser {
-  basic_xml_doc_handler<Node>& doc_handler;
+template <typename Node>
+void
+basic_default_xml_doc_handler<Node>::end_element(unsigned long lineno) {
+  const std::string::size_type pos{node_path.rfind('/')};
+  assert(pos != std::string::npos);
+  if (node_comment) {
+    thread_diagnostics() << "discarding comment before '" + node_path + "' end; line " << lineno << std::endl;
+    node_comment = xml_graph::xml_text{};
+  }
 
- public:
-  ~basic_xml_doc_parser();
-  basic_xml_doc_parser(basic_xml_doc_handler<Node>& doc_handler);
+  assert(doc_builder.in_node());
+  doc_builder.end_node();
 
-  std::unique_ptr<const Node> parse_doc(const char* file);
-};
+  node_path.resize(pos);
+}
 
-template <typename Node> basic_xml_doc_parser<Node>::~basic_xml_doc_parser() {
-  xercesc::XMLPlatformUtils::Terminate();
+template <typename Node>
+void
+basic_default_xml_doc_handler<Node>::handle_utf8_content(unsigned long lineno, const char* chars, std::size_t len) {
+  if (ignorable_newlines(chars, len) < 0) {
+    assert(!node_path.empty());
+    if (doc_builder.add_content(chars, len))
+      node_comment = xml_graph::xml_text{};
+  }
 }
 
-template <typename Node> basic_xml_doc_parser<Node>::basic_xml_doc_parser(basic_xml_doc_handler<Node>& doc_handler) : doc_handler(doc_handler) {
-  xercesc::XMLPlatformUtils::Initialize();
+template <typename Node>
+void
+basic_default_xml_doc_handler<Node>::handle_utf8_comment(unsigned long lineno, const char* chars, std::size_t len) {
+  node_comment = doc_builder.get_arena().copy(chars, len);
 }
 
+using default_xml_doc_handler = basic_default_xml_doc_handler<xml_graph::xml_node>;
+
+// initializes the Xerces platform once for the lifetime of the process (or of a batch run)
+struct xml_platform {
+  xml_platform() { xercesc::XMLPlatformUtils::Initialize(); }
+  ~xml_platform() { xercesc::XMLPlatformUtils::Terminate(); }
+
+  xml_platform(const xml_platform&) = delete;
+  xml_platform& operator=(const xml_platform&) = delete;
+};
+
 template <typename Node> class xml_doc_delegator : public xercesc::DefaultHandler {
   basic_xml_doc_handler<Node>& doc_handler;
   const xercesc::Locator* locator;
+  xml_source_finder source_finder;
 
-  void characters(const XMLCh* const buf, const XMLSize_t len) override { doc_handler.handle_content(*locator, buf, len); }
+  void characters(const XMLCh* const buf, const XMLSize_t len) override {
+    ++thread_parse_counters().characters_cnt;
+    doc_handler.handle_content(*locator, buf, len);
+  }
+  void startDocument() override { doc_handler.handle_start_document(*locator); }
   void endDocument() override { doc_handler.handle_end_document(*locator); }
-  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) override { doc_handler.handle_start_element(*locator, uri, localname, qname, attrs); }
-  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override { doc_handler.handle_end_element(*locator, uri, localname, qname); }
+  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) override {
+    source_finder.start_element();
+    doc_handler.handle_start_element(*locator, uri, localname, qname, attrs);
+  }
+  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override {
+    const char* chars;
+    std::size_t len;
+    if (source_finder.end_element(chars, len))
+      doc_handler.handle_utf8_element_source(chars, len);
+    doc_handler.handle_end_element(*locator, uri, localname, qname);
+  }
   void comment(const XMLCh* const buf, const XMLSize_t cnt) override { doc_handler.handle_comment(*locator, buf, cnt); }
   void processingInstruction(const XMLCh* const target, const XMLCh* const data) override { doc_handler.handle_processing_instruction(*locator, target, data); }
   void warning(const xercesc::SAXParseException& e) override { doc_handler.handle_warning(e); }
@@ -213,24 +303,131 @@ template <typename Node> class xml_doc_delegator : public xercesc::DefaultHandle
 
  public:
   xml_doc_delegator(basic_xml_doc_handler<Node>& doc_handler) : doc_handler{doc_handler}, locator{} {}
+
+  xml_source_finder& get_source_finder() { return source_finder; }
 };
 
-template <typename Node>
-std::unique_ptr<const Node>
-basic_xml_doc_parser<Node>::parse_doc(const char* file) {
-  std::unique_ptr<xercesc::SAX2XMLReader> parser{xercesc::XMLReaderFactory::createXMLReader()};
+// native: xml_scanner, with Xerces for whatever it can't handle; xerces: Xerces alone
+enum class xml_parser_backend { native, xerces };
+
+// requires a live xml_platform (even natively, for the fallback); one reader is created up front and reused for every parse_doc
+// call
+template <typename Node> class basic_xml_doc_parser {
+  basic_xml_doc_handler<Node>& doc_handler;
+  xml_doc_delegator<Node> doc_delegator;
+  std::unique_ptr<xercesc::SAX2XMLReader> parser;
+  const xml_parser_backend backend;
+  xml_scanner scanner;
+  // what the document handler says during a scan, held until the scan succeeds: for a document left to Xerces, it says it again
+  std::ostringstream scan_diagnostics;
+
+ public:
+  basic_xml_doc_parser(basic_xml_doc_handler<Node>& doc_handler, xml_parser_backend backend = xml_parser_backend::native);
+
+  xml_graph::xml_doc<Node> parse_doc(const char* file);
+  // parses the caller's buffer in place (it must outlive the call); system_id only names the document in diagnostics
+  xml_graph::xml_doc<Node> parse_doc(const char* buf, std::size_t len, const char* system_id);
+};
+
+template <typename Node> basic_xml_doc_parser<Node>::basic_xml_doc_parser(basic_xml_doc_handler<Node>& doc_handler, xml_parser_backend backend) : doc_handler(doc_handler), doc_delegator{doc_handler}, parser{xercesc::XMLReaderFactory::createXMLReader()}, backend{backend} {
   parser->setFeature(xercesc::XMLUni::fgSAX2CoreValidation, false);
   parser->setFeature(xercesc::XMLUni::fgSAX2CoreNameSpaces, false);
+  // off by default, and xml_source_finder needs it: without it getSrcOffset() throws
+  parser->setFeature(xercesc::XMLUni::fgXercesCalculateSrcOfs, true);
 
-  xml_doc_delegator<Node> doc_delegator{doc_handler};
   parser->setContentHandler(&doc_delegator);
   parser->setErrorHandler(&doc_delegator);
   parser->setLexicalHandler(&doc_delegator);
+}
 
+template <typename Node>
+xml_graph::xml_doc<Node>
+basic_xml_doc_parser<Node>::parse_doc(const char* file) {
+  doc_delegator.get_source_finder().reset(parser.get(), nullptr, 0);
   parser->parse(file);
+  if (parser->getErrorCount())
+    throw std::runtime_error{std::string{"can't parse '"} + file + '\''};
+  return doc_handler.doc();
+}
+
+template <typename Node>
+xml_graph::xml_doc<Node>
+basic_xml_doc_parser<Node>::parse_doc(const char* buf, std::size_t len, const char* system_id) {
+  if (backend == xml_parser_backend::native) {
+    scan_diagnostics.str(std::string{});
+    bool scanned;
+    {
+      const xml_diagnostics_redirect diagnostics_redirect{scan_diagnostics};
+      scanned = scanner.scan(buf, len, doc_handler);
+    }
+    if (scanned) {
+      thread_diagnostics() << scan_diagnostics.str();
+      thread_parse_counters().characters_cnt += scanner.get_counters().characters_cnt;
+      thread_parse_counters().transcoded_bytes += scanner.get_counters().text_bytes;
+      return doc_handler.doc();
+    }
+  }
+  xercesc::MemBufInputSource input_source{reinterpret_cast<const XMLByte*>(buf), len, system_id, false};
+  input_source.setCopyBufToStream(false);
+  doc_delegator.get_source_finder().reset(parser.get(), buf, len);
+  parser->parse(input_source);
+  if (parser->getErrorCount())
+    throw std::runtime_error{std::string{"can't parse '"} + system_id + '\''};
   return doc_handler.doc();
 }
 
 using xml_doc_parser = basic_xml_doc_parser<xml_graph::xml_node>;
+
+// passes Xerces' events on to an xml_utf8_handler, transcoded (and whitespace between elements dropped) as
+// basic_default_xml_doc_handler does
+class xml_utf8_delegator : public xercesc::DefaultHandler {
+  xml_utf8_handler& handler;
+  const xercesc::Locator* locator;
+  xml_source_finder source_finder;
+  std::string chars_buf;
+  std::string name_buf;
+
+  void characters(const XMLCh* const buf, const XMLSize_t len) override;
+  void startDocument() override { handler.handle_utf8_start_document(); }
+  void endDocument() override { handler.handle_utf8_end_document(locator->getLineNumber()); }
+  void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname, const xercesc_3_1::Attributes& attrs) override;
+  void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override;
+  void comment(const XMLCh* const buf, const XMLSize_t cnt) override;
+  void processingInstruction(const XMLCh* const target, const XMLCh* const data) override;
+  void warning(const xercesc::SAXParseException& e) override;
+  void error(const xercesc::SAXParseException& e) override;
+  void fatalError(const xercesc::SAXParseException& e) override;
+
+  void setDocumentLocator(const xercesc::Locator* locator) override { this->locator = locator; }
+
+ public:
+  xml_utf8_delegator(xml_utf8_handler& handler) : handler{handler}, locator{} {}
+
+  xml_source_finder& get_source_finder() { return source_finder; }
+};
+
+// parses a document a token at a time with Xerces' progressive parsing, so that the caller gets control back between tokens (to
+// hand output on, or to give up early); requires a live xml_platform
+class xml_stream_parser {
+  xml_utf8_delegator delegator;
+  std::unique_ptr<xercesc::SAX2XMLReader> parser;
+  std::unique_ptr<xercesc::MemBufInputSource> input_source;
+  xercesc::XMLPScanToken token;
+  std::string system_id;
+  bool parsing;
+
+ public:
+  xml_stream_parser(xml_utf8_handler& handler);
+  ~xml_stream_parser() { stop(); }
+  xml_stream_parser(const xml_stream_parser&) = delete;
+  xml_stream_parser& operator=(const xml_stream_parser&) = delete;
+
+  // starts on the caller's buffer (which must outlive the parse); system_id only names the document in diagnostics
+  void start(const char* buf, std::size_t len, const char* system_id);
+  // parses the next token; false once the document is done; throws if it can't be parsed
+  bool next();
+  // abandons the document, if it isn't done
+  void stop();
+};
 }
 #endif
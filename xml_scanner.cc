@@ -0,0 +1,536 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "xml_scanner.h"
+
+namespace xml_parser {
+using namespace std;
+
+namespace {
+enum char_class : unsigned char { name_start = 1, name_char = 2, space = 4, text_special = 8, forbidden = 16 };
+
+struct char_classes {
+  unsigned char classes[256];
+
+  char_classes() : classes{} {
+    for (unsigned int c = 'a'; c <= 'z'; ++c)
+      classes[c] = classes[c - 'a' + 'A'] = name_start | name_char;
+    classes['_'] = classes[':'] = name_start | name_char;
+    for (unsigned int c = '0'; c <= '9'; ++c)
+      classes[c] = name_char;
+    classes['-'] = classes['.'] = name_char;
+    // control characters other than whitespace aren't allowed anywhere in a document
+    for (unsigned int c = 0; c < 0x20; ++c)
+      classes[c] = forbidden | text_special;
+    classes[' '] = classes['\t'] = space;
+    classes['\n'] = classes['\r'] = space | text_special;
+    // character data runs on up to markup or a reference, and a "]]>" in it is an error
+    classes['<'] = classes['&'] = classes[']'] = text_special;
+  }
+
+  unsigned char operator[](char c) const { return classes[static_cast<unsigned char>(c)]; }
+};
+
+const char_classes classes;
+
+bool
+is_ascii(const char* buf, size_t len) {
+  size_t i{};
+  for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, buf + i, sizeof word);
+    if (word & 0x8080808080808080ULL)
+      return false;
+  }
+  for (; i < len; ++i) {
+    if (buf[i] & 0x80)
+      return false;
+  }
+  return true;
+}
+
+bool
+equals_ignore_case(const char* chars, size_t len, const char* lower_s) {
+  for (size_t i{}; i < len; ++i, ++lower_s) {
+    const char c{chars[i] >= 'A' && chars[i] <= 'Z' ? static_cast<char>(chars[i] - 'A' + 'a') : chars[i]};
+    if (!*lower_s || c != *lower_s)
+      return false;
+  }
+  return !*lower_s;
+}
+
+// one scan of one document: every scan_ function advances p past what it recognized, or returns false
+class scan_context {
+  string& text_buf;
+  vector<pair<const char*, size_t>>& open_names;
+  vector<pair<const char*, size_t>>& attr_names;
+  xml_utf8_handler& handler;
+  xml_scan_counters& counters;
+  const char* p;
+  const char* const end;
+  unsigned long lineno;
+  // whether elements' source is handed on: as with utf8_source() on the Xerces side, not in a document declared ISO-8859-1 (even
+  // though the scanner only takes one that's all ASCII), so that both sides splice the same documents
+  bool source;
+
+  bool at(const char* s, size_t len) const { return static_cast<size_t>(end - p) >= len && !memcmp(p, s, len); }
+  template <size_t N> bool at(const char (&s)[N]) const { return at(s, N - 1); }
+
+  // a line ends at "\r\n", '\r' or '\n'; c is at p
+  void count_line_end(char c) {
+    ++lineno;
+    if (c == '\r' && p + 1 < end && p[1] == '\n')
+      ++p;
+  }
+  void skip_space() {
+    for (; p < end && (classes[*p] & space); ++p) {
+      if (*p == '\n' || *p == '\r')
+        count_line_end(*p);
+    }
+  }
+  bool scan_name() {
+    if (p == end || !(classes[*p] & name_start))
+      return false;
+    for (++p; p < end && (classes[*p] & name_char); ++p) {}
+    return true;
+  }
+
+  // up to the terminator (which is skipped), counting lines and checking for forbidden characters; cr tells whether any line
+  // ends need normalizing
+  bool scan_until(const char* terminator, size_t terminator_len, bool& cr) {
+    cr = false;
+    for (;; ++p) {
+      const char* const next = static_cast<const char*>(memchr(p, terminator[0], static_cast<size_t>(end - p)));
+      if (!next)
+        return false;
+      for (; p < next; ++p) {
+        if (classes[*p] & forbidden)
+          return false;
+        if (*p == '\n' || *p == '\r') {
+          cr = cr || *p == '\r';
+          count_line_end(*p);
+        }
+      }
+      if (at(terminator, terminator_len)) {
+        p += terminator_len;
+        return true;
+      }
+    }
+  }
+  // copies chars to text_buf with each line end made a '\n'
+  void normalize_line_ends(const char* chars, size_t len) {
+    text_buf.clear();
+    for (size_t i{}; i < len; ++i) {
+      if (chars[i] != '\r')
+        text_buf += chars[i];
+      else {
+        text_buf += '\n';
+        if (i + 1 < len && chars[i + 1] == '\n')
+          ++i;
+      }
+    }
+  }
+
+  // &lt; &gt; &amp; &apos; &quot; and ASCII character references; anything else would need a DTD (or transcoding)
+  bool scan_reference(char& c) {
+    ++p;
+    if (p < end && *p == '#') {
+      ++p;
+      const bool hex{p < end && *p == 'x'};
+      if (hex)
+        ++p;
+      const char* const digits = p;
+      unsigned int value{};
+      for (; p < end && *p != ';'; ++p) {
+        unsigned int digit;
+        if (*p >= '0' && *p <= '9')
+          digit = static_cast<unsigned int>(*p - '0');
+        else if (hex && *p >= 'a' && *p <= 'f')
+          digit = static_cast<unsigned int>(*p - 'a' + 10);
+        else if (hex && *p >= 'A' && *p <= 'F')
+          digit = static_cast<unsigned int>(*p - 'A' + 10);
+        else
+          return false;
+        value = value * (hex ? 16 : 10) + digit;
+        if (value >= 0x80)
+          return false;
+      }
+      if (p == end || p == digits)
+        return false;
+      ++p;
+      c = static_cast<char>(value);
+      return !(classes[c] & forbidden);
+    }
+    const char* const name = p;
+    if (!scan_name() || p == end || *p != ';')
+      return false;
+    const size_t len{static_cast<size_t>(p++ - name)};
+    if (len == 2 && !memcmp(name, "lt", 2))
+      c = '<';
+    else if (len == 2 && !memcmp(name, "gt", 2))
+      c = '>';
+    else if (len == 3 && !memcmp(name, "amp", 3))
+      c = '&';
+    else if (len == 4 && !memcmp(name, "apos", 4))
+      c = '\'';
+    else if (len == 4 && !memcmp(name, "quot", 4))
+      c = '"';
+    else
+      return false;
+    return true;
+  }
+
+  // character data up to the next markup other than a CDATA section; Xerces hands it over in pieces split at references and
+  // CDATA sections, and handlers drop whitespace-only pieces, so it's reported as one piece unless that would make a difference
+  bool scan_content() {
+    text_buf.clear();
+    const char* run = p;
+    bool copied{};
+    bool piece_empty{true};
+    bool piece_space{true};
+    unsigned int space_piece_cnt{};
+    unsigned int text_piece_cnt{};
+    const auto end_piece = [&]() {
+      if (!piece_empty)
+        ++(piece_space ? space_piece_cnt : text_piece_cnt);
+      piece_empty = piece_space = true;
+    };
+    const auto copy_run = [&]() {
+      text_buf.append(run, static_cast<size_t>(p - run));
+      copied = true;
+    };
+
+    for (;;) {
+      unsigned char cls{};
+      for (; p < end && !((cls = classes[*p]) & text_special); ++p) {
+        piece_empty = false;
+        piece_space = piece_space && (cls & space);
+      }
+      if (p == end)
+        return false;
+      if (*p == '\n') {
+        piece_empty = false;
+        ++lineno;
+        ++p;
+      } else if (*p == '\r') {
+        piece_empty = false;
+        copy_run();
+        text_buf += '\n';
+        count_line_end(*p);
+        run = ++p;
+      } else if (*p == ']') {
+        if (at("]]>"))
+          return false;
+        piece_empty = piece_space = false;
+        ++p;
+      } else if (*p == '&') {
+        copy_run();
+        end_piece();
+        char c;
+        if (!scan_reference(c))
+          return false;
+        text_buf += c;
+        piece_empty = false;
+        piece_space = (classes[c] & space) != 0;
+        end_piece();
+        run = p;
+      } else if (at("<![CDATA[")) {
+        copy_run();
+        end_piece();
+        p += 9;
+        const char* const cdata = p;
+        bool cr;
+        if (!scan_until("]]>", 3, cr))
+          return false;
+        const size_t buf_len{text_buf.size()};
+        for (const char* c = cdata; c < p - 3; ++c) {
+          piece_space = piece_space && (classes[*c] & space);
+          if (*c != '\r')
+            text_buf += *c;
+          else if (c + 1 == p - 3 || c[1] != '\n')
+            text_buf += '\n';
+        }
+        piece_empty = text_buf.size() == buf_len;
+        end_piece();
+        run = p;
+      } else if (*p == '<')
+        break;
+      else
+        return false;
+    }
+    end_piece();
+    if (space_piece_cnt && text_piece_cnt)
+      return false;
+    counters.characters_cnt += space_piece_cnt + text_piece_cnt;
+    if (copied) {
+      copy_run();
+      if (!text_buf.empty()) {
+        counters.text_bytes += text_buf.size();
+        handler.handle_utf8_content(lineno, text_buf.data(), text_buf.size());
+      }
+    } else if (p > run) {
+      counters.text_bytes += static_cast<size_t>(p - run);
+      handler.handle_utf8_content(lineno, run, static_cast<size_t>(p - run));
+    }
+    return true;
+  }
+
+  bool scan_comment() {
+    p += 4;
+    const char* const comment = p;
+    bool cr;
+    // "--" may only end a comment
+    if (!scan_until("--", 2, cr) || p == end || *p != '>')
+      return false;
+    const size_t len{static_cast<size_t>(p - 2 - comment)};
+    ++p;
+    counters.text_bytes += len;
+    if (cr) {
+      normalize_line_ends(comment, len);
+      handler.handle_utf8_comment(lineno, text_buf.data(), text_buf.size());
+    } else
+      handler.handle_utf8_comment(lineno, comment, len);
+    return true;
+  }
+
+  bool scan_processing_instruction() {
+    p += 2;
+    const char* const target = p;
+    if (!scan_name())
+      return false;
+    const size_t target_len{static_cast<size_t>(p - target)};
+    // the XML declaration is only allowed first, and is scanned by scan_xml_declaration()
+    if (equals_ignore_case(target, target_len, "xml"))
+      return false;
+    const char* data = p;
+    if (!at("?>")) {
+      if (p == end || !(classes[*p] & space))
+        return false;
+      skip_space();
+      data = p;
+    }
+    bool cr;
+    if (!scan_until("?>", 2, cr))
+      return false;
+    const size_t data_len{static_cast<size_t>(p - 2 - data)};
+    counters.text_bytes += target_len + data_len;
+    if (cr) {
+      normalize_line_ends(data, data_len);
+      handler.handle_utf8_processing_instruction(lineno, target, target_len, text_buf.data(), text_buf.size());
+    } else
+      handler.handle_utf8_processing_instruction(lineno, target, target_len, data, data_len);
+    return true;
+  }
+
+  // a quoted attribute value, whose text is checked but not kept
+  bool scan_attribute_value() {
+    if (p == end || (*p != '"' && *p != '\''))
+      return false;
+    const char quote{*p++};
+    while (p < end) {
+      if (*p == quote) {
+        ++p;
+        return true;
+      }
+      if (*p == '<' || (classes[*p] & forbidden))
+        return false;
+      if (*p == '&') {
+        char c;
+        if (!scan_reference(c))
+          return false;
+        continue;
+      }
+      if (*p == '\n' || *p == '\r')
+        count_line_end(*p);
+      ++p;
+    }
+    return false;
+  }
+
+  bool scan_start_tag(const char*& name, size_t& name_len, bool& empty) {
+    ++p;
+    name = p;
+    if (!scan_name())
+      return false;
+    name_len = static_cast<size_t>(p - name);
+    attr_names.clear();
+    for (;;) {
+      const char* const before_space = p;
+      skip_space();
+      if (p == end)
+        return false;
+      if (*p == '>' || at("/>")) {
+        empty = *p == '/';
+        p += empty ? 2 : 1;
+        return true;
+      }
+      if (p == before_space)
+        return false;
+      const char* const attr_name = p;
+      if (!scan_name())
+        return false;
+      const size_t attr_name_len{static_cast<size_t>(p - attr_name)};
+      for (const auto& that : attr_names) {
+        if (that.second == attr_name_len && !memcmp(that.first, attr_name, attr_name_len))
+          return false;
+      }
+      attr_names.emplace_back(attr_name, attr_name_len);
+      skip_space();
+      if (p == end || *p != '=')
+        return false;
+      ++p;
+      skip_space();
+      if (!scan_attribute_value())
+        return false;
+    }
+  }
+
+  bool scan_end_tag() {
+    p += 2;
+    const char* const name = p;
+    if (!scan_name())
+      return false;
+    const size_t len{static_cast<size_t>(p - name)};
+    skip_space();
+    if (p == end || *p != '>' || open_names.empty() || open_names.back().second != len || memcmp(open_names.back().first, name, len))
+      return false;
+    ++p;
+    // the start tag's '<' is just before its name
+    const char* const start_tag{open_names.back().first - 1};
+    open_names.pop_back();
+    counters.text_bytes += len;
+    if (source)
+      handler.handle_utf8_element_source(start_tag, static_cast<size_t>(p - start_tag));
+    handler.handle_utf8_end_element(lineno, name, len);
+    return true;
+  }
+
+  // version 1.0 only (1.1 has other line ends), in an encoding that ASCII is a subset of
+  bool scan_xml_declaration() {
+    if (!at("<?xml") || end - p < 6 || !(classes[p[5]] & space))
+      return true;
+    p += 5;
+    static const char* const pseudo_attrs[] = {"version", "encoding", "standalone"};
+    for (unsigned int i{};;) {
+      const char* const before_space = p;
+      skip_space();
+      if (at("?>")) {
+        p += 2;
+        return i > 0;
+      }
+      const char* const attr_name = p;
+      if (p == before_space || !scan_name())
+        return false;
+      const size_t attr_name_len{static_cast<size_t>(p - attr_name)};
+      // version comes first, then each of the others at most once, in this order
+      for (const unsigned int first{i}; i < 3 && (strlen(pseudo_attrs[i]) != attr_name_len || memcmp(pseudo_attrs[i], attr_name, attr_name_len)); ++i) {
+        if (!first)
+          return false;
+      }
+      if (i == 3)
+        return false;
+      skip_space();
+      if (p == end || *p != '=')
+        return false;
+      ++p;
+      skip_space();
+      const char* const value = p + 1;
+      if (!scan_attribute_value())
+        return false;
+      const size_t value_len{static_cast<size_t>(p - 1 - value)};
+      if (i == 0 && !(value_len == 3 && !memcmp(value, "1.0", 3)))
+        return false;
+      if (i == 1 && equals_ignore_case(value, value_len, "iso-8859-1"))
+        source = false;
+      else if (i == 1 && !equals_ignore_case(value, value_len, "utf-8") && !equals_ignore_case(value, value_len, "us-ascii"))
+        return false;
+      if (i == 2 && !(value_len == 3 && !memcmp(value, "yes", 3)) && !(value_len == 2 && !memcmp(value, "no", 2)))
+        return false;
+      ++i;
+    }
+  }
+
+  // comments, processing instructions and whitespace before or after the root element
+  bool scan_misc() {
+    for (;;) {
+      skip_space();
+      if (at("<!--")) {
+        if (!scan_comment())
+          return false;
+      } else if (at("<?")) {
+        if (!scan_processing_instruction())
+          return false;
+      } else
+        return true;
+    }
+  }
+
+  bool scan_element() {
+    do {
+      if (p == end)
+        return false;
+      if (*p != '<' || at("<![CDATA[")) {
+        if (open_names.empty() || !scan_content())
+          return false;
+      } else if (at("</")) {
+        if (!scan_end_tag())
+          return false;
+      } else if (at("<!--")) {
+        if (!scan_comment())
+          return false;
+      } else if (at("<?")) {
+        if (!scan_processing_instruction())
+          return false;
+      } else if (at("<!"))
+        return false;
+      else {
+        const char* name;
+        size_t name_len;
+        bool empty;
+        if (!scan_start_tag(name, name_len, empty))
+          return false;
+        counters.text_bytes += name_len;
+        handler.handle_utf8_start_element(lineno, name, name_len);
+        if (empty) {
+          counters.text_bytes += name_len;
+          if (source)
+            handler.handle_utf8_element_source(name - 1, static_cast<size_t>(p - (name - 1)));
+          handler.handle_utf8_end_element(lineno, name, name_len);
+        } else
+          open_names.emplace_back(name, name_len);
+      }
+    } while (!open_names.empty());
+    return true;
+  }
+
+ public:
+  scan_context(string& text_buf, vector<pair<const char*, size_t>>& open_names, vector<pair<const char*, size_t>>& attr_names, xml_utf8_handler& handler, xml_scan_counters& counters, const char* buf, size_t len) : text_buf(text_buf), open_names(open_names), attr_names(attr_names), handler(handler), counters(counters), p{buf}, end{buf + len}, lineno{1}, source{true} { open_names.clear(); }
+
+  bool scan() {
+    // a UTF-8 byte order mark is all that may precede the XML declaration; anything else not ASCII is left to Xerces, which
+    // narrows non-ASCII text through the local code page
+    if (at("\xEF\xBB\xBF"))
+      p += 3;
+    if (!is_ascii(p, static_cast<size_t>(end - p)))
+      return false;
+    handler.handle_utf8_start_document();
+    if (!scan_xml_declaration() || !scan_misc())
+      return false;
+    if (p == end || *p != '<' || !scan_element() || !scan_misc() || p != end)
+      return false;
+    handler.handle_utf8_end_document(lineno);
+    return true;
+  }
+};
+}
+
+bool
+xml_scanner::scan(const char* buf, size_t len, xml_utf8_handler& handler) {
+  counters = xml_scan_counters{};
+  return scan_context{text_buf, open_names, attr_names, handler, counters, buf, len}.scan();
+}
+}
@@ -0,0 +1,54 @@
+#ifndef XML_SCANNER_H
+#define XML_SCANNER_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace xml_parser {
+
+// what xml_scanner reports: names and text are UTF-8, with references and line ends already resolved, and only valid during the
+// call; each event comes with the line it ends on, as Xerces' locator has it
+struct xml_utf8_handler {
+  virtual ~xml_utf8_handler() {}
+
+  virtual void handle_utf8_start_document() = 0;
+  virtual void handle_utf8_end_document(unsigned long lineno) = 0;
+  virtual void handle_utf8_start_element(unsigned long lineno, const char* name, std::size_t len) = 0;
+  virtual void handle_utf8_end_element(unsigned long lineno, const char* name, std::size_t len) = 0;
+  virtual void handle_utf8_content(unsigned long lineno, const char* chars, std::size_t len) = 0;
+  virtual void handle_utf8_comment(unsigned long lineno, const char* chars, std::size_t len) = 0;
+  virtual void handle_utf8_processing_instruction(unsigned long lineno, const char* target, std::size_t target_len, const char* data, std::size_t data_len) = 0;
+  // the element about to end as it is in the document's bytes, from its start tag's '<' to its end tag's '>': reported (just
+  // before handle_utf8_end_element) only by a parser that knows them, for a document whose bytes are the UTF-8 they stand for
+  virtual void handle_utf8_element_source(const char* chars, std::size_t len) {}
+};
+
+// what a scan handed on, to be counted as Xerces' parses are (see xml_parse_counters): the text runs Xerces would have reported
+// one characters() call each, and the bytes of the names and text reported (which Xerces would have transcoded)
+struct xml_scan_counters {
+  std::size_t characters_cnt;
+  std::size_t text_bytes;
+};
+
+// tokenizes the XML that POMs are made of straight from the document's bytes: elements and their attributes, text with the
+// predefined entity and character references, CDATA sections, comments and processing instructions, all in ASCII, and no DTD;
+// it reports what Xerces would, so a handler builds the same document from either
+class xml_scanner {
+  std::string text_buf;
+  std::vector<std::pair<const char*, std::size_t>> open_names;
+  std::vector<std::pair<const char*, std::size_t>> attr_names;
+  xml_scan_counters counters;
+
+ public:
+  xml_scanner() : counters{} {}
+
+  // false (possibly after some events) for a document using anything more, or that isn't well-formed: it must then be parsed
+  // again from the start by Xerces, which either handles it or says what's wrong with it
+  bool scan(const char* buf, std::size_t len, xml_utf8_handler& handler);
+  // what the last scan handed on
+  const xml_scan_counters& get_counters() const { return counters; }
+};
+}
+#endif
@@ -0,0 +1,23 @@
+#include <cstddef>
+#include <cstring>
+
+#include "xml_writer.h"
+
+namespace xml_graph {
+using namespace std;
+
+const size_t xml_writer::tab_run_len;
+const char xml_writer::tab_run[tab_run_len] = {'\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t', '\t'};
+
+void
+xml_writer::verbatim(const xml_text& text) {
+  const char* chars{text.data()};
+  const char* const end{chars + text.size()};
+  for (const char* cr; (cr = static_cast<const char*>(memchr(chars, '\r', static_cast<size_t>(end - chars))));) {
+    append(chars, static_cast<size_t>(cr - chars));
+    newline();
+    chars = cr + 1 != end && cr[1] == '\n' ? cr + 2 : cr + 1;
+  }
+  append(chars, static_cast<size_t>(end - chars));
+}
+}
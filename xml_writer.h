@@ -0,0 +1,95 @@
+#ifndef XML_WRITER_H
+#define XML_WRITER_H
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#include "xml_arena.h"
+#include "xml_name.h"
+
+namespace xml_graph {
+
+// serializes into one growing buffer (kept across documents), so a whole document goes out in a single write and nothing is
+// flushed line by line; alternatively it compares what it's given against expected bytes, keeping nothing
+class xml_writer {
+  static const std::size_t tab_run_len = 64;
+  static const char tab_run[tab_run_len];
+
+  std::string buf;
+  const char* expected;
+  std::size_t expected_len;
+  std::size_t matched_len;
+  bool differs;
+
+  void append(const char* chars, std::size_t len) {
+    if (!expected)
+      buf.append(chars, len);
+    else if (!differs) {
+      const std::size_t cmp_len{len < expected_len - matched_len ? len : expected_len - matched_len};
+      if (cmp_len == len && !std::memcmp(expected + matched_len, chars, len)) {
+        matched_len += len;
+        return;
+      }
+      for (std::size_t i{}; i < cmp_len && expected[matched_len] == chars[i]; ++i)
+        ++matched_len;
+      differs = true;
+    }
+  }
+
+ public:
+  xml_writer() : expected{}, expected_len{}, matched_len{}, differs{} {}
+
+  void clear() {
+    buf.clear();
+    expected = nullptr;
+  }
+  // from now on compare against (rather than keep) the output, until clear()
+  void expect(const char* chars, std::size_t len) {
+    buf.clear();
+    expected = chars ? chars : "";
+    expected_len = len;
+    matched_len = 0;
+    differs = false;
+  }
+  void reserve(std::size_t size) { buf.reserve(size); }
+  const char* data() const { return buf.data(); }
+  std::size_t size() const { return buf.size(); }
+
+  // false once the output has strayed from the expected bytes: writing anything more is pointless
+  explicit operator bool() const { return !differs; }
+  // whether the output was exactly the expected bytes; if not, they agree on the first mismatch_offset() bytes
+  bool matches() const { return !differs && matched_len == expected_len; }
+  std::size_t mismatch_offset() const { return matched_len; }
+
+  void indent(unsigned int level) {
+    for (; level > tab_run_len; level -= tab_run_len)
+      append(tab_run, tab_run_len);
+    append(tab_run, level);
+  }
+  void newline() { append("\n", 1); }
+  // a document's own bytes, as they are but for their line ends, which go out as '\n' like everything else written
+  void verbatim(const xml_text& text);
+
+  xml_writer& operator<<(char c) {
+    append(&c, 1);
+    return *this;
+  }
+  template <std::size_t N> xml_writer& operator<<(const char (&s)[N]) {
+    append(s, N - 1);
+    return *this;
+  }
+  xml_writer& operator<<(const xml_text& text) {
+    append(text.data(), text.size());
+    return *this;
+  }
+  xml_writer& operator<<(const xml_name& name) {
+    append(name.str().data(), name.str().size());
+    return *this;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const xml_writer& writer) { return os.write(writer.buf.data(), static_cast<std::streamsize>(writer.buf.size())); }
+};
+}
+#endif